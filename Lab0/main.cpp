@@ -1,82 +1,101 @@
 #include <iostream>
-#include <fstream>
 #include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
 
-enum State { NORMAL, IN_COMMENT, IN_STRING, IN_CHAR };
+#include "../common/durable.hpp"
+#include "../common/io.hpp"
+#include "../common/perf_stats.hpp"
+#include "../common/strip.hpp"
 
-int main() {
-    const char* fileName = "lab01.example.utf8.c";
-    const char* tempFileName = "temp_output.c";
-
-    std::ifstream in(fileName);
+// Очистка файла fileName во временный файл рядом с ним. Временный файл
+// добавляется в batch и заменит исходный при batch.commit().
+bool stripFile(const std::string& fileName, durable::Batch& batch, perf::Stats* stats) {
+    std::string error;
+    auto in = io::open_input(fileName, &error);
     if (!in) {
         std::cerr << "Не удалось открыть файл " << fileName << std::endl;
-        return 1;
+        return false;
     }
 
-    std::ofstream out(tempFileName);
+    std::string tempFileName;
+    int fd = durable::Batch::create_temp(fileName, tempFileName, &error);
+    if (fd < 0) {
+        std::cerr << "Не удалось создать временный файл для " << fileName << ": " << error << std::endl;
+        return false;
+    }
 
-    State state = NORMAL;
-    char c;
+    // Сжатый файл перезаписывается в том же формате сжатия
+    auto out = io::compressed_output(std::make_unique<io::FdOutput>(fd, true), in->compression());
+    out->set_observer(stats);
 
-    while (in.get(c)) {
-        switch(state) {
-            case NORMAL:
-                if (c == '/') {
-                    if (in.peek() == '*') {
-                        in.get(c);
-                        state = IN_COMMENT;
-                    } else {
-                        out.put(c);
-                    }
-                } else if (c == '"') {
-                    out.put(c);
-                    state = IN_STRING;
-                } else if (c == '\'') {
-                    out.put(c);
-                    state = IN_CHAR;
-                } else {
-                    out.put(c);
-                }
-                break;
+    perf::TimedInput<io::Input> timedIn(*in, stats);
+    strip::strip_stream(timedIn, *out, strip::Lab0Policy{});
 
-            case IN_COMMENT:
-                if (c == '*') {
-                    if (in.peek() == '/') {
-                        in.get(c);
-                        state = NORMAL;
-                    }
-                }
-                break;
+    if (!in->error().empty() || !out->close()) {
+        std::cerr << "Ошибка при обработке файла " << fileName << std::endl;
+        std::remove(tempFileName.c_str());
+        return false;
+    }
 
-            case IN_STRING:
-                out.put(c);
-                if (c == '\\') {
-                    if (in.get(c)) {
-                        out.put(c);
-                    }
-                } else if (c == '"') {
-                    state = NORMAL;
-                }
-                break;
+    if (!batch.add(fileName, tempFileName, &error)) {
+        std::cerr << "Ошибка при обработке файла " << fileName << ": " << error << std::endl;
+        return false;
+    }
+    return true;
+}
 
-            case IN_CHAR:
-                out.put(c);
-                if (c == '\\') {
-                    if (in.get(c)) {
-                        out.put(c);
-                    }
-                } else if (c == '\'') {
-                    state = NORMAL;
-                }
-                break;
+int main(int argc, char* argv[]) {
+    perf::Format perfFormat = perf::Format::NONE;
+    std::vector<std::string> fileNames;
+    for (int i = 1; i < argc; ++i) {
+        if (perf::parse_option(argv[i], perfFormat)) {
+            continue;
         }
+        if (argv[i][0] == '-') {
+            std::cerr << "Использование: " << argv[0] << " [--perf-stats[=json]] [файл...]" << std::endl;
+            return 1;
+        }
+        fileNames.push_back(argv[i]);
+    }
+    if (fileNames.empty()) {
+        fileNames.push_back("lab01.example.utf8.c");
     }
 
-    in.close();
-    out.close();
+    // Создается раньше выходов, чтобы пережить их
+    std::unique_ptr<perf::Stats> stats;
+    if (perfFormat != perf::Format::NONE) {
+        stats = std::make_unique<perf::Stats>();
+    }
 
-    std::rename(tempFileName, fileName);
+    // Все файлы сначала пишутся во временные, затем заменяются группой:
+    // одна синхронизация на все файлы, и каждая замена атомарна
+    durable::Batch batch;
+    int failures = 0;
+    for (const std::string& fileName : fileNames) {
+        if (!stripFile(fileName, batch, stats.get())) {
+            ++failures;
+        }
+    }
+
+    // Синхронизация и переименование относятся к записи
+    if (stats) {
+        stats->before_write();
+    }
+    std::string error;
+    bool committed = batch.commit(&error);
+    if (stats) {
+        stats->after_write();
+    }
+    if (!committed) {
+        std::cerr << "Не удалось заменить файлы: " << error << std::endl;
+        return 1;
+    }
+
+    if (stats) {
+        stats->report(std::cerr, perfFormat);
+    }
 
-    return 0;
-}
\ No newline at end of file
+    return failures == 0 ? 0 : 1;
+}
@@ -1,68 +1,58 @@
-#include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
 
-enum State { NORMAL, SLASH, MULTI_COMMENT, STAR_IN_COMMENT };
+#include "../common/io.hpp"
+#include "../common/perf_stats.hpp"
+#include "../common/strip.hpp"
 
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    std::cerr << "Usage: " << argv[0] << " <input file> <output file>"
+  perf::Format perf_format = perf::Format::NONE;
+  int arg = 1;
+  while (arg < argc && perf::parse_option(argv[arg], perf_format)) {
+    ++arg;
+  }
+  if (argc - arg != 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--perf-stats[=json]] <input file> <output file>"
               << std::endl;
     return 1;
   }
 
-  std::ifstream in(argv[1], std::ios::binary);
+  // Создается раньше выхода, чтобы пережить его.
+  std::unique_ptr<perf::Stats> stats;
+  if (perf_format != perf::Format::NONE) {
+    stats = std::make_unique<perf::Stats>();
+  }
+
+  std::string error;
+  auto in = io::open_input(argv[arg], &error);
   if (!in) {
-    std::cerr << "Could not open input file." << std::endl;
+    std::cerr << "Could not open input file: " << error << std::endl;
     return 1;
   }
 
-  std::ofstream out(argv[2], std::ios::binary);
+  auto out = io::open_output(argv[arg + 1], &error);
   if (!out) {
-    std::cerr << "Could not open output file." << std::endl;
+    std::cerr << "Could not open output file: " << error << std::endl;
     return 1;
   }
+  out->set_observer(stats.get());
+
+  perf::TimedInput<io::Input> timed_in(*in, stats.get());
+  strip::strip_stream(timed_in, *out, strip::BlockPolicy{});
 
-  State state = NORMAL;
-  char c;
-  while (in.get(c)) {
-    switch (state) {
-    case NORMAL:
-      if (c == '/') {
-        state = SLASH;
-      } else {
-        out.put(c);
-      }
-      break;
-    case SLASH:
-      if (c == '*') {
-        state = MULTI_COMMENT;
-      } else if (c == '/') {
-        out.put('/');
-      } else {
-        out.put('/');
-        out.put(c);
-        state = NORMAL;
-      }
-      break;
-    case MULTI_COMMENT:
-      if (c == '*') {
-        state = STAR_IN_COMMENT;
-      }
-      break;
-    case STAR_IN_COMMENT:
-      if (c == '/') {
-        state = NORMAL;
-      } else if (c != '*') {
-        state = MULTI_COMMENT;
-      }
-      break;
-    }
+  if (!in->error().empty()) {
+    std::cerr << "Could not read input file: " << in->error() << std::endl;
+    return 1;
   }
-  if (state == SLASH) {
-    out.put('/');
+  if (!out->close()) {
+    std::cerr << "Could not write output file: " << out->error() << std::endl;
+    return 1;
   }
 
-  in.close();
-  out.close();
+  if (stats) {
+    stats->report(std::cerr, perf_format);
+  }
   return 0;
 }
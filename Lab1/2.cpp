@@ -1,126 +1,835 @@
-#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
 
-enum State {
-  NORMAL,
-  SLASH,
-  MULTI_COMMENT,
-  STAR_IN_MULTI_COMMENT,
-  SINGLE_COMMENT,
-  IN_STRING,
-  IN_CHAR,
-  SLASH_IN_STRING,
-  SLASH_IN_CHAR
+#include "../common/boilerplate.hpp"
+#include "../common/comments.hpp"
+#include "../common/dialect.hpp"
+#include "../common/io.hpp"
+#include "../common/jit.hpp"
+#include "../common/perf_stats.hpp"
+#include "../common/pipeline.hpp"
+#include "../common/sample.hpp"
+#include "../common/strip.hpp"
+#include "../common/tar.hpp"
+#include "../common/trace.hpp"
+#include "../common/watch.hpp"
+
+namespace fs = std::filesystem;
+
+// Способ обработки файла (--engine).
+enum class Engine {
+  AUTO,      // по образцу входа
+  SCALAR,    // автомат в одном потоке
+  JIT,       // автомат C в машинном коде (jit.hpp)
+  ZERO_COPY, // перенос неизмененных участков ядром (strip_mapped)
+  PIPELINE   // чтение и запись в отдельных потоках (pipeline.hpp)
 };
 
-int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    std::cerr << "Usage: " << argv[0] << " <input file> <output file>"
-              << std::endl;
-    return 1;
+const char *const engine_names[] = {"auto", "scalar", "jit", "zero-copy",
+                                    "pipeline"};
+
+// Параметры очистки, общие для всех режимов.
+struct Options {
+  bool skip_if0 = false; // вырезать также области #if 0 (только для C)
+  bool minify = false;   // сжимать пробелы (только для C)
+  Engine engine = Engine::AUTO;
+  std::size_t min_span = 8192; // для ZERO_COPY
+  bool log_engine = false;     // выбранный способ - в stderr
+  // Язык входа; nullptr - по расширению каждого файла (--dialect auto).
+  const dialect::Dialect *dialect = dialect::find("c");
+  // Известные блоки в начале файлов (только C, без --minify).
+  const boilerplate::Set *boilerplate = nullptr;
+  // Выдача вырезанных комментариев (--comments, только C).
+  comments::Writer *comments = nullptr;
+};
+
+// Язык файла path: заданный явно или по расширению, по умолчанию C.
+const dialect::Dialect &dialect_of(const Options &options,
+                                   std::string_view path) {
+  const dialect::Dialect *d = options.dialect;
+  if (!d) {
+    d = dialect::for_path(path);
+  }
+  return d ? *d : *dialect::find("c");
+}
+
+// Для C работает автомат из strip.hpp, для остальных языков - автомат
+// по описанию из dialect.hpp.
+bool is_c(const dialect::Dialect &d) { return d.name == "c"; }
+
+// Вызов f с политикой автомата C, соответствующей options.
+template <class F> bool with_policy(const Options &options, F f) {
+  if (options.minify) {
+    return options.skip_if0 ? f(strip::FullSkipMinifyPolicy{})
+                            : f(strip::FullMinifyPolicy{});
+  }
+  return options.skip_if0 ? f(strip::FullSkipPolicy{})
+                          : f(strip::FullPolicy{});
+}
+
+using Source = sample::Prefixed<io::Input>;
+
+// Прогон автомата (strip::Stripper, jit::Stripper или dialect::Stripper)
+// по всему входу: в одном потоке или конвейером.
+template <class Automaton>
+void run_automaton(Automaton &engine, Source &in, io::Output &out,
+                   bool pipelined, perf::Stats *stats) {
+  if (pipelined) {
+    pipeline::Pipeline<Source> pipe(in, out);
+    std::string_view chunk;
+    while (pipe.next(chunk)) {
+      engine.feed(chunk, pipe.sink());
+    }
+    engine.finish(pipe.sink());
+    pipe.finish();
+    if (stats) {
+      stats->add_input(pipe.input_bytes());
+    }
+    return;
+  }
+  perf::TimedInput<Source> timed_in(in, stats);
+  trace::TracedInput<perf::TimedInput<Source>> traced_in(timed_in);
+  std::vector<char> buf(io::block_size);
+  while (std::size_t n = traced_in.read(buf.data(), buf.size())) {
+    engine.feed({buf.data(), n}, out);
+  }
+  engine.finish(out);
+}
+
+// Очистка отображенного файла с байта from: неизмененные участки длиной
+// от min_span переносятся в выход ядром, автомат только находит их
+// границы.
+template <class P>
+void strip_mapped(const io::MappedFile &in, std::size_t from,
+                  io::FdOutput &out, std::size_t min_span,
+                  perf::Stats *stats) {
+  if (stats) {
+    stats->add_input(in.data().size() - from);
+  }
+  io::SpanSink sink(in, out, min_span);
+  trace::Span span("automaton");
+  strip::Stripper<P> stripper;
+  stripper.feed(in.data().substr(from), sink);
+  stripper.finish(sink);
+  sink.finish();
+}
+
+// Выбор способа по образцу (--engine=auto). Вход, целиком уместившийся в
+// образец, обрабатывается обычным циклом. Почти без комментариев выход
+// почти совпадает со входом - его переносит ядро. При частых комментариях
+// быстрее всего машинный код, который пропускает их без ветвления по
+// состоянию. Сжатый или потоковый большой вход на нескольких ядрах идет
+// конвейером, чтобы чтение с распаковкой и запись шли параллельно
+// автомату.
+Engine choose_engine(const sample::Profile &profile, bool c,
+                     const Options &options, bool fd_output) {
+  constexpr double sparse = 0.05; // доля комментариев
+  constexpr std::uint64_t large = 1 << 20;
+  if (profile.complete()) {
+    return Engine::SCALAR;
+  }
+  if (c && profile.mappable && fd_output && !options.minify &&
+      profile.comments < sparse) {
+    return Engine::ZERO_COPY;
+  }
+  if (c && !options.skip_if0 && !options.minify &&
+      profile.comments >= sparse && jit::compiled<strip::FullPolicy>()) {
+    return Engine::JIT;
+  }
+  if (std::thread::hardware_concurrency() > 1 && !profile.mappable &&
+      (profile.size == 0 || profile.size >= large)) {
+    return Engine::PIPELINE;
+  }
+  return Engine::SCALAR;
+}
+
+// Способ, которым файл будет обработан на самом деле: недоступный способ
+// заменяется обычным циклом. Комментарии выдает только strip::Stripper.
+Engine usable_engine(Engine engine, bool c, const Options &options,
+                     bool fd_output, const io::MappedFile &mapped) {
+  switch (engine) {
+  case Engine::JIT:
+    if (!c || options.skip_if0 || options.minify || options.comments ||
+        !jit::compiled<strip::FullPolicy>()) {
+      return Engine::SCALAR;
+    }
+    break;
+  case Engine::ZERO_COPY:
+    if (!c || !fd_output || !mapped.valid() || options.min_span == 0 ||
+        options.comments) {
+      return Engine::SCALAR;
+    }
+    break;
+  default:
+    break;
+  }
+  return engine;
+}
+
+// Очистка потока по выбранному способу; первые skip байт файла уже
+// обработаны (известный блок), in начинается после них.
+void strip_with(Engine engine, const dialect::Dialect &d,
+                const io::MappedFile &mapped, std::size_t skip, Source &in,
+                io::Output &out, const Options &options, perf::Stats *stats) {
+  bool pipelined = engine == Engine::PIPELINE;
+  if (engine == Engine::ZERO_COPY) {
+    with_policy(options, [&](auto policy) {
+      strip_mapped<decltype(policy)>(mapped, skip,
+                                     dynamic_cast<io::FdOutput &>(out),
+                                     options.min_span, stats);
+      return true;
+    });
+  } else if (!is_c(d)) {
+    dialect::Stripper engine(d);
+    run_automaton(engine, in, out, pipelined, stats);
+  } else if (engine == Engine::JIT) {
+    jit::Stripper<strip::FullPolicy> engine(
+        *jit::compiled<strip::FullPolicy>());
+    run_automaton(engine, in, out, pipelined, stats);
+  } else if (options.comments) {
+    with_policy(options, [&](auto policy) {
+      strip::Stripper<decltype(policy), comments::Writer> engine(
+          *options.comments);
+      run_automaton(engine, in, out, pipelined, stats);
+      return true;
+    });
+  } else {
+    with_policy(options, [&](auto policy) {
+      strip::Stripper<decltype(policy)> engine;
+      run_automaton(engine, in, out, pipelined, stats);
+      return true;
+    });
+  }
+}
+
+// Очистка одного потока из файла path (или stdin для "-"); при ошибке
+// false и сообщение в error. Первый блок входа служит образцом для выбора
+// способа и затем первым уходит в автомат; известный блок в его начале
+// (--boilerplate) заменяется готовым образом без автомата.
+bool strip_file(io::Input &in, io::Output &out, const std::string &path,
+                const Options &options, perf::Stats *stats,
+                std::string &error) {
+  const dialect::Dialect &d = dialect_of(options, path);
+  sample::Profile profile;
+  std::string head;
+  {
+    trace::Span span("read");
+    head = sample::read_head(in);
   }
+  std::error_code ec;
+  profile.compressed = in.compression() != io::Compression::NONE;
+  // У сжатого файла размер на диске ничего не говорит о размере входа.
+  if (!profile.compressed && path != "-" && fs::is_regular_file(path, ec)) {
+    profile.size = fs::file_size(path, ec);
+    profile.mappable = true;
+  }
+  sample::measure(head, profile);
+
+  bool fd_output = dynamic_cast<io::FdOutput *>(&out) != nullptr;
+  Engine engine = options.engine;
+  if (engine == Engine::AUTO) {
+    engine = choose_engine(profile, is_c(d), options, fd_output);
+  }
+  io::MappedFile mapped(engine == Engine::ZERO_COPY && profile.mappable
+                            ? path
+                            : std::string());
+  engine = usable_engine(engine, is_c(d), options, fd_output, mapped);
+  // Комментарии известного блока тоже нужны в выдаче --comments.
+  const boilerplate::Block *known = nullptr;
+  if (options.boilerplate && is_c(d) && !options.comments) {
+    known = options.boilerplate->match(head);
+  }
+  std::size_t skip = known ? known->text.size() : 0;
+  if (options.log_engine) {
+    std::cerr << "engine: " << engine_names[static_cast<int>(engine)]
+              << (options.engine == Engine::AUTO ? "" : " (forced)") << " for "
+              << path << " (" << d.name << ", " << profile.describe();
+    if (known) {
+      std::cerr << ", boilerplate " << skip << " bytes";
+    }
+    std::cerr << ")" << std::endl;
+  }
+
+  // В конвейере запись идет в своем потоке и в замеры не попадает.
+  trace::WriteSpans write_spans(engine == Engine::PIPELINE ? nullptr : stats);
+  out.set_observer(&write_spans);
+  if (known) {
+    out.write(known->image.data(), known->image.size());
+    if (stats) {
+      stats->add_input(skip);
+      stats->add_skipped(skip);
+    }
+  }
+  if (options.comments && is_c(d)) {
+    options.comments->start_file(path);
+  }
+  Source source(std::string_view(head).substr(skip), in);
+  strip_with(engine, d, mapped, skip, source, out, options, stats);
+  bool closed = out.close();
+  out.set_observer(nullptr);
 
-  std::ifstream in(argv[1], std::ios::binary);
+  if (!in.error().empty()) {
+    error = "Could not read input file: " + in.error();
+    return false;
+  }
+  if (!closed) {
+    error = "Could not write output file: " + out.error();
+    return false;
+  }
+  return true;
+}
+
+// Добавляет в set известный блок из файла path (не длиннее образца).
+// Блок должен состоять из комментариев и пробелов и кончаться переводом
+// строки: тогда после него автомат снова в начальном состоянии, и пропуск
+// блока не меняет выход. Образ строится той же политикой, что и выход.
+bool add_boilerplate(boilerplate::Set &set, const std::string &path,
+                     const Options &options, std::string &error) {
+  auto in = io::open_input(path, &error);
   if (!in) {
-    std::cerr << "Could not open input file." << std::endl;
-    return 1;
+    error = "Could not open boilerplate file: " + error;
+    return false;
   }
+  std::string text = sample::read_head(*in);
+  char extra;
+  if (in->read(&extra, 1) != 0) {
+    error = "Boilerplate file " + path + " is longer than " +
+            std::to_string(io::block_size) + " bytes";
+    return false;
+  }
+  if (!in->error().empty()) {
+    error = "Could not read boilerplate file: " + in->error();
+    return false;
+  }
+
+  std::string image;
+  std::string probe;
+  with_policy(options, [&](auto policy) {
+    strip::StringSink image_sink{image};
+    strip::strip(text, image_sink, policy);
+    strip::StringSink probe_sink{probe};
+    strip::strip(text + "x\n", probe_sink, policy);
+    return true;
+  });
+  bool blank = image.find_first_not_of(" \t\r\n\f\v") == std::string::npos;
+  if (text.empty() || text.back() != '\n' || !blank ||
+      probe != image + "x\n") {
+    error = "Boilerplate file " + path +
+            " is not a comment block ending with a newline";
+    return false;
+  }
+  set.add(std::move(text), std::move(image));
+  return true;
+}
 
-  std::ofstream out(argv[2], std::ios::binary);
-  if (!out) {
-    std::cerr << "Could not open output file." << std::endl;
+// Очистка файла rel из дерева src в то же место дерева dst. Запись идет
+// во временный файл, который затем переименовывается, поэтому читатели
+// выходного дерева не видят частично записанный файл. Сжатие выхода
+// повторяет сжатие входа.
+bool strip_tree_file(const fs::path &src, const fs::path &dst,
+                     const std::string &rel, const Options &options,
+                     perf::Stats *stats, std::string &error) {
+  trace::Span file_span("file", rel);
+  fs::path input = src / rel;
+  fs::path output = dst / rel;
+  std::string temp = output.string() + ".tmp";
+  std::error_code ec;
+  std::unique_ptr<io::Input> in;
+  std::unique_ptr<io::Output> out;
+  {
+    trace::Span span("open");
+    in = io::open_input(input.string(), &error);
+    if (!in) {
+      error = "Could not open input file " + input.string() + ": " + error;
+      return false;
+    }
+    fs::create_directories(output.parent_path(), ec);
+    out = io::open_output(temp, in->compression(), &error);
+    if (!out) {
+      error = "Could not open output file " + temp + ": " + error;
+      return false;
+    }
+  }
+
+  if (!strip_file(*in, *out, input.string(), options, stats, error)) {
+    fs::remove(temp, ec);
+    error += " (" + input.string() + ")";
+    return false;
+  }
+  trace::Span span("rename");
+  fs::rename(temp, output, ec);
+  if (ec) {
+    error = "Could not rename " + temp + ": " + ec.message();
+    return false;
+  }
+  return true;
+}
+
+// Режим --tree: очистка всех файлов дерева. Возвращает число ошибок.
+int strip_tree(const fs::path &src, const fs::path &dst,
+               const Options &options, perf::Stats *stats) {
+  int failures = 0;
+  for (const std::string &rel : watch::list_files(src.string())) {
+    std::string error;
+    if (!strip_tree_file(src, dst, rel, options, stats, error)) {
+      std::cerr << error << std::endl;
+      ++failures;
+    }
+  }
+  return failures;
+}
+
+// Режим --watch: дерево очищается целиком один раз, затем при каждом
+// изменении заново очищаются только измененные файлы, а выходы удаленных
+// файлов удаляются. Работает до прерывания.
+int watch_tree(const fs::path &src, const fs::path &dst,
+               const Options &options, std::chrono::milliseconds debounce) {
+  // Наблюдатель ставится до первого прохода, чтобы не потерять изменения.
+  watch::TreeWatcher watcher(src.string());
+  if (!watcher.ok()) {
+    std::cerr << "Could not watch input tree: " << watcher.error()
+              << std::endl;
     return 1;
   }
+  strip_tree(src, dst, options, nullptr);
+  std::cout << "Watching " << src.string() << std::endl;
 
-  State state = NORMAL;
-  char c;
-
-  while (in.get(c)) {
-    switch (state) {
-    case NORMAL:
-      if (c == '/') {
-        state = SLASH;
-      } else if (c == '"') {
-        out.put(c);
-        state = IN_STRING;
-      } else if (c == '\'') {
-        out.put(c);
-        state = IN_CHAR;
-      } else {
-        out.put(c);
-      }
-      break;
+  for (;;) {
+    std::vector<watch::Change> changes = watcher.wait(debounce);
+    if (!watcher.ok()) {
+      std::cerr << "Could not watch input tree: " << watcher.error()
+                << std::endl;
+      return 1;
+    }
 
-    case SLASH:
-      if (c == '*') {
-        state = MULTI_COMMENT;
-      } else if (c == '/') {
-        state = SINGLE_COMMENT;
-      } else {
-        out.put('/');
-        out.put(c);
-        state = NORMAL;
+    auto start = std::chrono::steady_clock::now();
+    int stripped = 0;
+    int removed = 0;
+    for (const watch::Change &change : changes) {
+      std::error_code ec;
+      if (change.kind == watch::ChangeKind::REMOVED) {
+        removed += fs::remove_all(dst / change.path, ec) > 0;
+        continue;
       }
-      break;
-
-    case MULTI_COMMENT:
-      if (c == '*') {
-        state = STAR_IN_MULTI_COMMENT;
+      std::string error;
+      if (strip_tree_file(src, dst, change.path, options, nullptr, error)) {
+        ++stripped;
+      } else if (fs::exists(src / change.path, ec)) {
+        // Файл, удаленный сразу после записи, ошибкой не считается.
+        std::cerr << error << std::endl;
       }
-      break;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::cout << "Updated " << stripped << " file(s), removed " << removed
+              << " in " << elapsed.count() / 1000.0 << " ms" << std::endl;
+  }
+}
 
-    case STAR_IN_MULTI_COMMENT:
-      if (c == '/') {
-        out.put(' ');
-        state = NORMAL;
-      } else if (c != '*') {
-        state = MULTI_COMMENT;
-      }
-      break;
+// Очистка одного файла (или stdin/stdout).
+int strip_single(const char *input, const char *output,
+                 const Options &options, perf::Stats *stats) {
+  trace::Span file_span("file", input);
+  std::string error;
+  std::unique_ptr<io::Input> in;
+  std::unique_ptr<io::Output> out;
+  {
+    trace::Span span("open");
+    in = io::open_input(input, &error);
+    if (!in) {
+      std::cerr << "Could not open input file: " << error << std::endl;
+      return 1;
+    }
+    out = io::open_output(output, &error);
+    if (!out) {
+      std::cerr << "Could not open output file: " << error << std::endl;
+      return 1;
+    }
+  }
+
+  if (!strip_file(*in, *out, input, options, stats, error)) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Очистка члена архива обычным автоматом: блоки из in идут в автомат по
+// мере чтения, а выход копится в out - его размер нужен для заголовка
+// раньше данных. Память растет только с прочитанными данными, а не с
+// размером из заголовка.
+template <class Input>
+void strip_member(const dialect::Dialect &d, Input &in, std::string &out,
+                  const Options &options) {
+  strip::StringSink sink{out};
+  std::vector<char> buf(io::block_size);
+  auto run = [&](auto &engine) {
+    while (std::size_t n = in.read(buf.data(), buf.size())) {
+      engine.feed({buf.data(), n}, sink);
+    }
+    engine.finish(sink);
+  };
+  if (!is_c(d)) {
+    dialect::Stripper engine(d);
+    run(engine);
+  } else if (options.comments) {
+    with_policy(options, [&](auto policy) {
+      strip::Stripper<decltype(policy), comments::Writer> engine(
+          *options.comments);
+      run(engine);
+      return true;
+    });
+  } else {
+    with_policy(options, [&](auto policy) {
+      strip::Stripper<decltype(policy)> engine;
+      run(engine);
+      return true;
+    });
+  }
+}
 
-    case SINGLE_COMMENT:
-      if (c == '\n' || c == '\r') {
-        out.put(c);
-        state = NORMAL;
+// Режим --tar: архив tar (файл или stdin) очищается по мере чтения, без
+// распаковки на диск, в архив tar с теми же членами. Обычные файлы
+// очищаются на языке из --dialect, как в других режимах; при --dialect auto
+// язык выбирается по расширению, а члены с неизвестным расширением
+// копируются. Остальные члены (и сжатые файлы) копируются как есть. Очищаемый член идет в автомат
+// блоками, а в памяти копится только его выход, пока не станет известен
+// размер для заголовка.
+int strip_archive(const char *input, const char *output,
+                  const Options &options, perf::Stats *stats) {
+  trace::Span archive_span("file", input);
+  std::string error;
+  std::unique_ptr<io::Input> in;
+  std::unique_ptr<io::Output> out;
+  {
+    trace::Span span("open");
+    in = io::open_input(input, &error);
+    if (!in) {
+      std::cerr << "Could not open input file: " << error << std::endl;
+      return 1;
+    }
+    out = io::open_output(output, &error);
+    if (!out) {
+      std::cerr << "Could not open output file: " << error << std::endl;
+      return 1;
+    }
+  }
+  trace::WriteSpans write_spans(stats);
+  out->set_observer(&write_spans);
+
+  perf::TimedInput<io::Input> timed_in(*in, stats);
+  tar::Reader<perf::TimedInput<io::Input>> reader(timed_in);
+  tar::Writer writer(*out);
+  tar::Member member;
+  std::string stripped;
+  std::vector<char> buf(io::block_size);
+  while (reader.next(member)) {
+    trace::Span file_span("file", member.name);
+    const dialect::Dialect *d = nullptr;
+    if (member.regular() &&
+        io::compression_from_name(member.name) == io::Compression::NONE) {
+      d = options.dialect ? options.dialect : dialect::for_path(member.name);
+    }
+    if (!d) {
+      writer.begin(member, member.size);
+      while (std::size_t n = reader.read(buf.data(), buf.size())) {
+        writer.write(buf.data(), n);
       }
-      break;
+      writer.end();
+      continue;
+    }
 
-    case IN_STRING:
-      out.put(c);
-      if (c == '\\') {
-        state = SLASH_IN_STRING;
-      } else if (c == '"') {
-        state = NORMAL;
+    std::string head;
+    {
+      trace::Span span("read");
+      head = sample::read_head(reader);
+    }
+    if (!reader.error().empty()) {
+      break;
+    }
+    std::string_view rest = head;
+    stripped.clear();
+    const boilerplate::Block *known = nullptr;
+    if (options.boilerplate && is_c(*d) && !options.comments) {
+      known = options.boilerplate->match(head);
+    }
+    if (known) {
+      stripped = known->image;
+      rest.remove_prefix(known->text.size());
+      if (stats) {
+        stats->add_skipped(known->text.size());
       }
+    }
+    if (options.comments && is_c(*d)) {
+      options.comments->start_file(member.name);
+    }
+    {
+      trace::Span span("automaton");
+      sample::Prefixed<decltype(reader)> source(rest, reader);
+      strip_member(*d, source, stripped, options);
+    }
+    if (!reader.error().empty()) {
       break;
+    }
+    writer.begin(member, stripped.size());
+    writer.write(stripped.data(), stripped.size());
+    writer.end();
+  }
 
-    case IN_CHAR:
-      out.put(c);
-      if (c == '\\') {
-        state = SLASH_IN_CHAR;
-      } else if (c == '\'') {
-        state = NORMAL;
+  if (!reader.error().empty() || !in->error().empty()) {
+    std::cerr << "Could not read input archive: "
+              << (in->error().empty() ? reader.error() : in->error())
+              << std::endl;
+    return 1;
+  }
+  writer.finish();
+  bool closed = out->close();
+  out->set_observer(nullptr);
+  if (!closed) {
+    std::cerr << "Could not write output file: " << out->error() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+void print_usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [--perf-stats[=json]] <input file> <output file>\n"
+            << "       " << program
+            << " [--perf-stats[=json]] --tree <input dir> <output dir>\n"
+            << "       " << program
+            << " [--perf-stats[=json]] --tar <input tar> <output tar>\n"
+            << "       " << program
+            << " --watch [--debounce MS] <input dir> <output dir>\n"
+            << "In --tar mode (\"-\" is stdin/stdout) regular members are "
+               "stripped as they are\n"
+            << "read, with the scalar automaton (with --dialect auto only "
+               "those of a known\n"
+            << "extension); other members are copied as is.\n"
+            << "Options for any mode:\n"
+            << "  --dialect NAME|auto  language of the input; auto picks by "
+               "file extension,\n"
+            << "                       C otherwise\n"
+            << "  --skip-if0           drop #if 0 regions (C only)\n"
+            << "  --minify             collapse whitespace (C only)\n"
+            << "  --engine=NAME        auto (default: chosen from a sample "
+               "of each file),\n"
+            << "                       scalar, jit, zero-copy or pipeline; "
+               "the\n"
+            << "                       choice is logged with --log-engine\n"
+            << "  --log-engine         print the engine chosen for each file "
+               "to stderr\n"
+            << "                       (also done by text --perf-stats)\n"
+            << "  --jit                same as --engine=jit: the C automaton "
+               "as x86-64 code\n"
+            << "  --zero-copy[=MIN]    same as --engine=zero-copy: unchanged "
+               "spans of at\n"
+            << "                       least MIN bytes (8192) are copied by "
+               "the kernel\n"
+            << "  --pipeline           same as --engine=pipeline: read and "
+               "write in\n"
+            << "                       separate threads\n"
+            << "  --boilerplate FILE   a known comment block (e.g. a license "
+               "header);\n"
+            << "                       files starting with it skip the "
+               "automaton for it\n"
+            << "                       (C only, not with --minify; may be "
+               "repeated)\n"
+            << "  --comments FILE      also write the removed comments "
+               "(offset, line, kind,\n"
+            << "                       text) to FILE in the same pass; C "
+               "only, not in\n"
+            << "                       --watch mode\n"
+            << "  --comments-format=jsonl|binary\n"
+            << "                       format of --comments (jsonl by "
+               "default)\n"
+            << "  --trace FILE         write a Chrome trace (not in --watch "
+               "mode)"
+            << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  enum { SINGLE, TREE, WATCH, TAR } mode = SINGLE;
+  perf::Format perf_format = perf::Format::NONE;
+  long debounce_ms = 5;
+  Options options;
+  std::string trace_path;
+  std::vector<std::string> boilerplate_paths;
+  std::string comments_path;
+  comments::Format comments_format = comments::Format::JSONL;
+  int arg = 1;
+  for (; arg < argc && std::string_view(argv[arg]).substr(0, 2) == "--";
+       ++arg) {
+    std::string_view option = argv[arg];
+    if (perf::parse_option(option, perf_format)) {
+      continue;
+    }
+    if (option == "--tree") {
+      mode = TREE;
+    } else if (option == "--watch") {
+      mode = WATCH;
+    } else if (option == "--tar") {
+      mode = TAR;
+    } else if (option == "--skip-if0") {
+      options.skip_if0 = true;
+    } else if (option == "--minify") {
+      options.minify = true;
+    } else if (option == "--log-engine") {
+      options.log_engine = true;
+    } else if (option.substr(0, 9) == "--engine=") {
+      auto name = std::find(std::begin(engine_names), std::end(engine_names),
+                            option.substr(9));
+      if (name == std::end(engine_names)) {
+        print_usage(argv[0]);
+        return 1;
       }
-      break;
+      options.engine = static_cast<Engine>(name - std::begin(engine_names));
+    } else if (option == "--jit") {
+      options.engine = Engine::JIT;
+    } else if (option == "--pipeline") {
+      options.engine = Engine::PIPELINE;
+    } else if (option == "--zero-copy") {
+      options.engine = Engine::ZERO_COPY;
+    } else if (option.substr(0, 12) == "--zero-copy=") {
+      long min_span = std::strtol(argv[arg] + 12, nullptr, 10);
+      if (min_span < 0) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      options.engine = Engine::ZERO_COPY;
+      options.min_span = static_cast<std::size_t>(min_span);
+    } else if (option == "--trace" && arg + 1 < argc) {
+      trace_path = argv[++arg];
+    } else if (option == "--boilerplate" && arg + 1 < argc) {
+      boilerplate_paths.push_back(argv[++arg]);
+    } else if (option == "--comments" && arg + 1 < argc) {
+      comments_path = argv[++arg];
+    } else if (option == "--comments-format=jsonl") {
+      comments_format = comments::Format::JSONL;
+    } else if (option == "--comments-format=binary") {
+      comments_format = comments::Format::BINARY;
+    } else if (option == "--dialect" && arg + 1 < argc) {
+      std::string_view name = argv[++arg];
+      options.dialect = dialect::find(name);
+      if (!options.dialect && name != "auto") {
+        std::cerr << "Unknown dialect: " << name << " (known:";
+        for (const dialect::Dialect &d : dialect::dialects) {
+          std::cerr << ' ' << d.name;
+        }
+        std::cerr << ", auto)" << std::endl;
+        return 1;
+      }
+    } else if (option == "--debounce" && arg + 1 < argc) {
+      debounce_ms = std::strtol(argv[++arg], nullptr, 10);
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc - arg != 2 || debounce_ms < 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
 
-    case SLASH_IN_STRING:
-      out.put(c);
-      state = IN_STRING;
-      break;
+  if ((mode == TREE || mode == WATCH) &&
+      watch::inside(argv[arg], argv[arg + 1])) {
+    std::cerr << "Output directory must not be inside the input directory."
+              << std::endl;
+    return 1;
+  }
+  if ((options.skip_if0 || options.minify || !boilerplate_paths.empty() ||
+       !comments_path.empty()) &&
+      options.dialect && !is_c(*options.dialect)) {
+    std::cerr << "--skip-if0, --minify, --boilerplate and --comments apply "
+                 "to the C dialect only."
+              << std::endl;
+    return 1;
+  }
+  if (options.minify && !boilerplate_paths.empty()) {
+    std::cerr << "--boilerplate is not supported with --minify." << std::endl;
+    return 1;
+  }
+  boilerplate::Set boilerplate;
+  for (const std::string &path : boilerplate_paths) {
+    std::string error;
+    if (!add_boilerplate(boilerplate, path, options, error)) {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+  }
+  if (!boilerplate.empty()) {
+    options.boilerplate = &boilerplate;
+  }
+  if (mode == WATCH && (!trace_path.empty() || !comments_path.empty())) {
+    std::cerr << "--trace and --comments are not supported in watch mode."
+              << std::endl;
+    return 1;
+  }
+  if (mode == WATCH) {
+    return watch_tree(argv[arg], argv[arg + 1], options,
+                      std::chrono::milliseconds(debounce_ms));
+  }
 
-    case SLASH_IN_CHAR:
-      out.put(c);
-      state = IN_CHAR;
-      break;
+  // Создаются раньше выхода, чтобы пережить его.
+  std::unique_ptr<trace::Recorder> tracer;
+  if (!trace_path.empty()) {
+    tracer = std::make_unique<trace::Recorder>();
+  }
+  std::unique_ptr<perf::Stats> stats;
+  if (perf_format != perf::Format::NONE) {
+    stats = std::make_unique<perf::Stats>();
+    // В JSON-отчет строки журнала не подмешиваются без --log-engine.
+    options.log_engine |= perf_format == perf::Format::TEXT;
+  }
+  std::unique_ptr<io::Output> comments_out;
+  std::unique_ptr<comments::Writer> comments;
+  if (!comments_path.empty()) {
+    std::string error;
+    comments_out = io::open_output(comments_path, &error);
+    if (!comments_out) {
+      std::cerr << "Could not open comments file: " << error << std::endl;
+      return 1;
     }
+    comments = std::make_unique<comments::Writer>(*comments_out,
+                                                  comments_format);
+    options.comments = comments.get();
   }
 
-  if (state == SLASH) {
-    out.put('/');
+  int status = 0;
+  if (mode == TREE) {
+    if (!fs::is_directory(argv[arg])) {
+      std::cerr << "Input is not a directory: " << argv[arg] << std::endl;
+      return 1;
+    }
+    status = strip_tree(argv[arg], argv[arg + 1], options, stats.get()) != 0;
+  } else if (mode == TAR) {
+    status = strip_archive(argv[arg], argv[arg + 1], options, stats.get());
+  } else {
+    status = strip_single(argv[arg], argv[arg + 1], options, stats.get());
   }
 
-  in.close();
-  out.close();
+  std::string error;
+  if (comments_out && !comments_out->close()) {
+    std::cerr << "Could not write comments file: " << comments_out->error()
+              << std::endl;
+    status = 1;
+  }
+  if (tracer && !tracer->write(trace_path, &error)) {
+    std::cerr << "Could not write trace file: " << error << std::endl;
+    status = 1;
+  }
+  if (stats && status == 0) {
+    stats->report(std::cerr, perf_format);
+  }
 
-  return 0;
+  return status;
 }
@@ -1,594 +1,884 @@
 #include <iostream>
-#include <fstream>
 #include <string>
-#include <cctype>
+#include <string_view>
+#include <initializer_list>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <memory>
+#include <map>
+#include <chrono>
+#include <filesystem>
+
+#include "../common/io.hpp"
+#include "scanner.hpp"
+#include "literal_table.hpp"
+#include "state_index.hpp"
+#include "parallel_scan.hpp"
+#include "../common/perf_stats.hpp"
+#include "../common/pipeline.hpp"
+#include "../common/dialect.hpp"
+#include "../common/sample.hpp"
+#include "../common/tar.hpp"
+#include "../common/trace.hpp"
+#include "../common/watch.hpp"
+
+// Разбор потока блоками; handler вызывается для каждой константы.
+// Source - любой объект с методом std::size_t read(char*, std::size_t).
+// skip_if0 - пропускать области #if 0. Возвращает число прочитанных байт.
+template <class Source, class Handler>
+std::uint64_t scan_stream(Source& in, Handler handler, bool skip_if0 = false)
+{
+    Scanner<Handler> scanner(std::move(handler));
+    scanner.set_skip_disabled(skip_if0);
+    std::vector<char> buf(io::block_size);
+    std::uint64_t total = 0;
+    while (std::size_t n = in.read(buf.data(), buf.size()))
+    {
+        scanner.feed({buf.data(), n});
+        total += n;
+    }
+    scanner.finish();
+    return total;
+}
 
-// Состояния внешнего автомата (комментарии, строки)
-enum State
+// Строка отчета: поля через табуляцию. Out - io::Output или
+// pipeline::BlockSink
+template <class Out>
+void write_line(Out& out, std::initializer_list<std::string_view> fields)
 {
-    NORMAL,
-    SLASH,
-    MULTI_COMMENT,
-    STAR_IN_MULTI_COMMENT,
-    SINGLE_COMMENT,
-    IN_STRING,
-    IN_CHAR,
-    SLASH_IN_STRING,
-    SLASH_IN_CHAR
-};
+    bool first = true;
+    for (std::string_view field : fields)
+    {
+        if (!first)
+        {
+            out.put('\t');
+        }
+        out.write(field.data(), field.size());
+        first = false;
+    }
+    out.put('\n');
+}
 
-// Состояния внутреннего автомата для распознавания чисел
-enum NumberState
+// Режим --freq: частотный отчет по всем константам из набора файлов
+int frequency_report(const char* report_path, std::vector<const char*> files, unsigned threads, bool skip_if0,
+                     perf::Stats* stats)
 {
-    IDLE, // Начальное состояние (не число)
-    START_ZERO, // Встретили '0'
-    OCTAL, // Внутри восьмеричного числа (после '0')
-    DECIMAL, // Внутри десятичного числа
-    HEX_START, // Встретили '0x' или '0X'
-    HEX, // Внутри шестнадцатеричного числа
-    NUMBER_END_POTENTIAL_SUFFIX, // Числовая часть закончилась, след. символ - буква
-    SUFFIX_U, // Встретили 'u' в суффиксе
-    SUFFIX_L, // Встретили 'l' в суффиксе
-    SUFFIX_LL, // Встретили 'll' в суффиксе
-    SUFFIX_UL, // Встретили 'ul' или 'lu'
-    SUFFIX_ULL, // Встретили 'ull' или 'llu'
-    INVALID // Недопустимая последовательность
-};
+    LiteralTable table;
+    std::atomic<std::size_t> next_file{0};
+    std::atomic<bool> failed{false};
+    std::atomic<std::uint64_t> input_bytes{0};
+
+    auto worker = [&]()
+    {
+        for (std::size_t i = next_file++; i < files.size(); i = next_file++)
+        {
+            // Сначала считаем вхождения внутри файла, затем сливаем в общую таблицу
+            trace::Span file_span("file", files[i]);
+            LocalLiteralTable local;
+            auto file_index = static_cast<std::uint32_t>(i);
+            std::string error;
+            std::unique_ptr<io::Input> in;
+            {
+                trace::Span span("open");
+                in = io::open_input(files[i], &error);
+            }
+            if (!in)
+            {
+                std::cerr << "Could not open input file " << files[i] << ": " << error << std::endl;
+                failed = true;
+                continue;
+            }
+            trace::TracedInput<io::Input> traced_in(*in);
+            input_bytes += scan_stream(traced_in, [&](const Literal& lit)
+            {
+                local.add(lit.text, lit.type, Location{file_index, lit.line, lit.offset});
+            }, skip_if0);
+            if (!in->error().empty())
+            {
+                std::cerr << "Could not read input file " << files[i] << ": " << in->error() << std::endl;
+                failed = true;
+            }
+            trace::Span span("merge");
+            local.for_each([&](const LiteralStats& stats) { table.add(stats); });
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : pool)
+    {
+        t.join();
+    }
+
+    if (stats)
+    {
+        stats->add_input(input_bytes);
+    }
+
+    trace::Span report_span("report");
+    std::string error;
+    trace::WriteSpans write_spans(stats);
+    auto report_out = io::open_output(report_path, &error);
+    if (!report_out)
+    {
+        std::cerr << "Could not open report file: " << error << std::endl;
+        return 1;
+    }
+    report_out->set_observer(&write_spans);
+    for (const LiteralStats& entry : table.sorted())
+    {
+        std::string where = std::string(files[entry.first.file]) + ':' + std::to_string(entry.first.line);
+        write_line(*report_out, {std::to_string(entry.count), entry.text, entry.type, where});
+    }
+    if (!report_out->close())
+    {
+        std::cerr << "Could not write report file: " << report_out->error() << std::endl;
+        return 1;
+    }
 
-// Функция для определения типа константы по суффиксам
-// (l_count: 0 для нет 'l', 1 для 'l', 2 для 'll')
-std::string get_int_type(bool has_u, int l_count)
+    return failed ? 1 : 0;
+}
+
+// Таблицы констант по файлам дерева (ключ - путь относительно корня)
+using TreeTables = std::map<std::string, std::unique_ptr<LocalLiteralTable>>;
+
+// Разбор одного файла дерева в его таблицу
+bool scan_tree_file(const std::string& root, const std::string& rel, bool skip_if0, TreeTables& tables,
+                    std::string& error)
 {
-    if (has_u)
+    std::string path = root + '/' + rel;
+    auto in = io::open_input(path, &error);
+    if (!in)
+    {
+        error = "Could not open input file " + path + ": " + error;
+        return false;
+    }
+    auto local = std::make_unique<LocalLiteralTable>();
+    scan_stream(*in, [&](const Literal& lit)
+    {
+        local->add(lit.text, lit.type, Location{0, lit.line, lit.offset});
+    }, skip_if0);
+    if (!in->error().empty())
     {
-        if (l_count == 0) return "unsigned int";
-        if (l_count == 1) return "unsigned long";
-        return "unsigned long long"; // l_count = 2
+        error = "Could not read input file " + path + ": " + in->error();
+        return false;
     }
-    if (l_count == 0) return "int"; // Тип по умолчанию
-    if (l_count == 1) return "long";
-    return "long long"; // l_count = 2
+    tables[rel] = std::move(local);
+    return true;
 }
 
-// Функция для проверки, является ли символ разделителем (завершает токен)
-bool is_delimiter(char c)
+// Частотный отчет по сохраненным таблицам в том же формате, что и --freq
+// (файлы - в порядке путей). Пишется во временный файл и переименовывается,
+// чтобы читатели не видели недописанный отчет.
+bool write_tree_report(const std::string& report_path, const TreeTables& tables)
 {
-    return std::isspace(c) || std::string("+-*/%=(){}[];,<>&|^!~?#:").find(c) != std::string::npos;
+    LiteralTable table;
+    std::vector<const std::string*> names;
+    for (const auto& [rel, local] : tables)
+    {
+        auto file_index = static_cast<std::uint32_t>(names.size());
+        names.push_back(&rel);
+        local->for_each([&](LiteralStats stats)
+        {
+            stats.first.file = file_index;
+            table.add(stats);
+        });
+    }
+
+    std::string error;
+    std::string temp = report_path + ".tmp";
+    auto report_out = io::open_output(temp, io::compression_from_name(report_path), &error);
+    if (!report_out)
+    {
+        std::cerr << "Could not open report file: " << error << std::endl;
+        return false;
+    }
+    for (const LiteralStats& entry : table.sorted())
+    {
+        std::string where = *names[entry.first.file] + ':' + std::to_string(entry.first.line);
+        write_line(*report_out, {std::to_string(entry.count), entry.text, entry.type, where});
+    }
+    if (!report_out->close())
+    {
+        std::cerr << "Could not write report file: " << report_out->error() << std::endl;
+        return false;
+    }
+    if (std::rename(temp.c_str(), report_path.c_str()) != 0)
+    {
+        std::cerr << "Could not rename report file: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
 }
 
-int main(int argc, char* argv[])
+// Режим --watch: частотный отчет по дереву, который обновляется после
+// каждого изменения. Заново разбираются только измененные файлы; таблицы
+// остальных берутся из памяти. Работает до прерывания.
+int watch_report(const std::string& root, const std::string& report_path, bool skip_if0,
+                 std::chrono::milliseconds debounce)
 {
-    if (argc != 3)
+    // Наблюдатель ставится до первого прохода, чтобы не потерять изменения
+    watch::TreeWatcher watcher(root);
+    if (!watcher.ok())
     {
-        std::cerr << "Usage: " << argv[0] << " <input file> <report file>" << std::endl;
+        std::cerr << "Could not watch input tree: " << watcher.error() << std::endl;
         return 1;
     }
-
-    std::ifstream in(argv[1], std::ios::binary);
-    if (!in)
+    TreeTables tables;
+    std::string error;
+    for (const std::string& rel : watch::list_files(root))
+    {
+        if (!scan_tree_file(root, rel, skip_if0, tables, error))
+        {
+            std::cerr << error << std::endl;
+        }
+    }
+    if (!write_tree_report(report_path, tables))
     {
-        std::cerr << "Could not open input file." << std::endl;
         return 1;
     }
+    std::cout << "Watching " << root << std::endl;
 
-    std::ofstream report_out(argv[2]);
+    for (;;)
+    {
+        std::vector<watch::Change> changes = watcher.wait(debounce);
+        if (!watcher.ok())
+        {
+            std::cerr << "Could not watch input tree: " << watcher.error() << std::endl;
+            return 1;
+        }
 
-    State state = NORMAL;
-    NumberState num_state = IDLE;
-    std::string current_token;
-    char c;
-    // Символ, сохраненный для проверки на принадлежность к суффиксу
-    char potential_suffix_char = 0;
-    bool has_u = false;
-    int l_count = 0;
-    bool saw_digit = false;
+        auto start = std::chrono::steady_clock::now();
+        std::size_t scanned = 0;
+        for (const watch::Change& change : changes)
+        {
+            if (change.kind == watch::ChangeKind::REMOVED)
+            {
+                // Удален файл или целый каталог
+                std::string prefix = change.path + '/';
+                tables.erase(change.path);
+                auto it = tables.lower_bound(prefix);
+                while (it != tables.end() && it->first.compare(0, prefix.size(), prefix) == 0)
+                {
+                    it = tables.erase(it);
+                }
+                continue;
+            }
+            if (scan_tree_file(root, change.path, skip_if0, tables, error))
+            {
+                ++scanned;
+            }
+            else
+            {
+                // Файл, удаленный сразу после записи, ошибкой не считается
+                tables.erase(change.path);
+                if (std::filesystem::exists(root + '/' + change.path))
+                {
+                    std::cerr << error << std::endl;
+                }
+            }
+        }
+        if (!write_tree_report(report_path, tables))
+        {
+            return 1;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Rescanned " << scanned << " file(s), report updated in " << elapsed.count() / 1000.0 << " ms"
+                  << std::endl;
+    }
+}
+
+void print_usage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [--threads N] <input file> <report file>" << std::endl;
+    std::cerr << "       " << program << " --freq [--threads N] <report file> <input file>..." << std::endl;
+    std::cerr << "       " << program << " --index-write [--interval BYTES] <input file> <index file>" << std::endl;
+    std::cerr << "       " << program << " --range START-END <input file> <index file> <report file>" << std::endl;
+    std::cerr << "       " << program << " --lines FIRST-LAST <input file> <index file> <report file>" << std::endl;
+    std::cerr << "       " << program << " --watch [--debounce MS] <input dir> <report file>" << std::endl;
+    std::cerr << "       " << program << " --tar <input tar> <report file>" << std::endl;
+    std::cerr << "Any mode may be preceded by --perf-stats[=json] and, except the index modes," << std::endl;
+    std::cerr << "by --skip-if0 (skip #if 0 regions; --threads then has no effect)." << std::endl;
+    std::cerr << "Modes other than --watch may be preceded by --trace FILE (Chrome trace events)." << std::endl;
+    std::cerr << "The first mode may be preceded by --engine=auto|scalar|parallel|pipeline" << std::endl;
+    std::cerr << "(default auto: chosen from the first block; --pipeline is --engine=pipeline;" << std::endl;
+    std::cerr << "--threads N forces parallel with N threads, or scalar for N = 1)." << std::endl;
+    std::cerr << "--log-engine (also implied by text --perf-stats) prints the chosen engine to stderr." << std::endl;
+}
+
+// Разбор "A-B" в пару чисел
+bool parse_range(const std::string& text, std::uint64_t& from, std::uint64_t& to)
+{
+    std::size_t dash = text.find('-');
+    if (dash == std::string::npos || dash == 0 || dash + 1 == text.size())
+    {
+        return false;
+    }
+    char* end = nullptr;
+    from = std::strtoull(text.c_str(), &end, 10);
+    if (end != text.c_str() + dash)
+    {
+        return false;
+    }
+    to = std::strtoull(text.c_str() + dash + 1, &end, 10);
+    return *end == '\0' && from <= to;
+}
+
+// Разбор неотрицательного десятичного числа без знака и лишних символов
+bool parse_count(const char* text, std::uint64_t& value)
+{
+    if (*text < '0' || *text > '9')
+    {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoull(text, &end, 10);
+    return *end == '\0' && errno != ERANGE;
+}
+
+// Режим --index-write: файл-спутник с контрольными точками состояния
+int index_write(const char* input_path, const char* index_path, std::uint64_t interval, perf::Stats* stats)
+{
+    StateIndex index;
+    std::string error;
+    if (!build_index(input_path, interval, index, error))
+    {
+        std::cerr << "Could not index input file: " << error << std::endl;
+        return 1;
+    }
+    if (stats)
+    {
+        stats->add_input(index.file_size);
+    }
+    if (!write_index(index_path, index))
+    {
+        std::cerr << "Could not write index file." << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
-    // --- Лямбда-функция для финализации токена ---
-    // Вызывается ПЕРЕД обработкой символа, который ЗАВЕРШАЕТ токен
-    auto finalize_token = [&]()
+// Режим --tar: отчет по архиву tar (файл или stdin) без распаковки на
+// диск. Разбираются обычные файлы C и C++ (по расширению), по мере чтения
+// архива; каждая строка отчета начинается с имени члена.
+int archive_report(const char* input_path, const char* report_path, bool skip_if0, perf::Stats* stats)
+{
+    trace::Span archive_span("file", input_path);
+    std::string error;
+    std::unique_ptr<io::Input> in;
+    std::unique_ptr<io::Output> report_out;
     {
-        if (current_token.empty())
+        trace::Span span("open");
+        in = io::open_input(input_path, &error);
+        if (!in)
         {
-            // Не выводим ничего для пустого токена
-            num_state = IDLE;
-            potential_suffix_char = 0;
-            has_u = false;
-            l_count = 0;
-            saw_digit = false;
-            return;
+            std::cerr << "Could not open input file: " << error << std::endl;
+            return 1;
         }
-        // --- Основная логика анализа ---
-        // 1. Если автомат уже в состоянии INVALID, это точно ошибка
-        if (num_state == INVALID)
+        report_out = io::open_output(report_path, &error);
+        if (!report_out)
         {
-            report_out << current_token << "\tERROR" << std::endl;
+            std::cerr << "Could not open report file: " << error << std::endl;
+            return 1;
         }
-        else
+    }
+    trace::WriteSpans write_spans(stats);
+    report_out->set_observer(&write_spans);
+
+    using Reader = tar::Reader<perf::TimedInput<io::Input>>;
+    perf::TimedInput<io::Input> timed_in(*in, stats);
+    Reader reader(timed_in);
+    tar::Member member;
+    while (reader.next(member))
+    {
+        const dialect::Dialect* d = nullptr;
+        if (member.regular() && io::compression_from_name(member.name) == io::Compression::NONE)
         {
-            // Считаем, что если не INVALID, то автомат уже определил тип и валидность
-            // Здесь просто выводим результат
-            report_out << current_token << "\t" << get_int_type(has_u, l_count) << std::endl;
+            d = dialect::for_path(member.name);
         }
-        // --- Сброс состояния и токена в конце финализации ---
-        current_token = "";
-        num_state = IDLE;
-        potential_suffix_char = 0;
-        has_u = false;
-        l_count = 0;
-        saw_digit = false;
-    };
-    // --- Конец лямбда-функции finalize_token ---
+        if (!d || (d->name != "c" && d->name != "cpp"))
+        {
+            continue;
+        }
+        trace::Span file_span("file", member.name);
+        trace::TracedInput<Reader> traced_in(reader);
+        scan_stream(traced_in, [&](const Literal& lit)
+        {
+            write_line(*report_out, {member.name, lit.text, lit.type});
+        }, skip_if0);
+    }
 
-    // --- Основной цикл чтения файла ---
-    while (in.get(c))
+    if (!reader.error().empty() || !in->error().empty())
     {
-        // Вспомогательная переменная для повторной обработки символа
-        char char_to_reprocess = 0;
+        std::cerr << "Could not read input archive: " << (in->error().empty() ? reader.error() : in->error())
+                  << std::endl;
+        return 1;
+    }
+    if (!report_out->close())
+    {
+        std::cerr << "Could not write report file: " << report_out->error() << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
-    process_char_again: // Метка для повторной обработки
+// Режимы --range и --lines: разбор только участка файла по индексу.
+// Байтовый диапазон полуоткрыт [START, END), диапазон строк - [FIRST, LAST].
+int range_report(bool by_lines, std::uint64_t from, std::uint64_t to,
+                 const char* input_path, const char* index_path, const char* report_path, perf::Stats* stats)
+{
+    StateIndex index;
+    if (!read_index(index_path, index))
+    {
+        std::cerr << "Could not read index file (rebuild it with --index-write)." << std::endl;
+        return 1;
+    }
 
-        // Если есть символ для повторной обработки, используем его
-        if (char_to_reprocess != 0)
+    // Последняя контрольная точка не позже начала диапазона
+    std::size_t first = 0;
+    for (std::size_t i = 0; i < index.checkpoints.size(); ++i)
+    {
+        const ScannerState& s = index.checkpoints[i].state;
+        if ((by_lines ? s.line : s.offset) > from)
         {
-            c = char_to_reprocess;
+            break;
         }
+        first = i;
+    }
+
+    std::string error;
+    auto report_out = io::open_output(report_path, &error);
+    if (!report_out)
+    {
+        std::cerr << "Could not open report file: " << error << std::endl;
+        return 1;
+    }
+    report_out->set_observer(stats);
 
-        // 0. Обработка смены основного состояния (комментарии, строки)
-        if (state == NORMAL)
+    auto in_range = [&](const Literal& lit)
+    {
+        return by_lines ? lit.line >= from && lit.line <= to : lit.offset >= from && lit.offset < to;
+    };
+    auto report = [&](const Literal& lit)
+    {
+        if (in_range(lit))
         {
-            // Проверяем, не начинается ли комментарий или строка
-            if (c == '/')
-            {
-                // Может быть комментарий ИЛИ завершение числа перед оператором
-                finalize_token(); // Завершаем предыдущий токен (если был)
-                state = SLASH; // Переходим в состояние проверки '/'
-                continue; // Переходим к след. итерации для обработки '/' в SLASH
-            }
-            if (c == '"')
-            {
-                finalize_token();
-                state = IN_STRING;
-                continue;
-            }
-            if (c == '\'')
-            {
-                finalize_token();
-                state = IN_CHAR;
-                continue;
-            }
-            // Если это не начало комм/строки, остаемся в NORMAL
+            write_line(*report_out, {lit.text, lit.type});
         }
-        else
+    };
+    // Участок пройден, если автомат ушел за его конец и токен не висит
+    auto done = [&](const auto& scanner)
+    {
+        std::uint64_t position = by_lines ? scanner.current_line() : scanner.current_offset();
+        return (by_lines ? position > to : position >= to) && !scanner.in_token();
+    };
+
+    std::uint64_t scanned = 0;
+    if (!scan_from_checkpoint(input_path, index, first, report, done, error, &scanned))
+    {
+        std::cerr << "Could not scan input file: " << error << std::endl;
+        return 1;
+    }
+    if (stats)
+    {
+        stats->add_input(scanned);
+    }
+    if (!report_out->close())
+    {
+        std::cerr << "Could not write report file: " << report_out->error() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Способ разбора файла в первом режиме (--engine)
+enum class Engine
+{
+    AUTO,     // по образцу входа
+    SCALAR,   // один поток
+    PARALLEL, // по частям в нескольких потоках (parallel_scan.hpp)
+    PIPELINE  // чтение и запись в отдельных потоках (pipeline.hpp)
+};
+
+const char* const engine_names[] = {"auto", "scalar", "parallel", "pipeline"};
+
+// Общие параметры режимов
+struct Options
+{
+    bool skip_if0 = false;
+    Engine engine = Engine::AUTO;
+    bool log_engine = false; // печатать выбранный способ в stderr
+};
+
+// Выбор способа по образцу (--engine=auto). Большой несжатый файл на
+// нескольких ядрах разбирается по частям; при плотных константах, на
+// которые уходит основная работа автомата и запись отчета, - уже с 1 МиБ.
+// Сжатый или потоковый большой вход идет конвейером, чтобы распаковка и
+// запись шли параллельно автомату. Остальное - в одном потоке.
+Engine choose_engine(const sample::Profile& profile, bool skip_if0, unsigned cores)
+{
+    constexpr std::uint64_t large = 1 << 20;
+    if (profile.complete() || cores < 2)
+    {
+        return Engine::SCALAR;
+    }
+    std::uint64_t split = profile.literals >= 0.1 ? large : 4 * large;
+    if (profile.mappable && !skip_if0 && profile.size >= split)
+    {
+        return Engine::PARALLEL;
+    }
+    if (!profile.mappable && (profile.size == 0 || profile.size >= large))
+    {
+        return Engine::PIPELINE;
+    }
+    return Engine::SCALAR;
+}
+
+int run(int argc, char* argv[], const Options& options, perf::Stats* stats)
+{
+    bool skip_if0 = options.skip_if0;
+    if (argc >= 2 && std::string(argv[1]) == "--freq")
+    {
+        unsigned threads = std::thread::hardware_concurrency();
+        int arg = 2;
+        if (arg + 1 < argc && std::string(argv[arg]) == "--threads")
         {
-            // Мы НЕ в NORMAL, обрабатываем комментарии/строки и т.д.
-            // (Логика как в Лаб 1, но без вывода символов)
-            switch (state)
-            {
-            case SLASH:
-                if (c == '*') state = MULTI_COMMENT;
-                else if (c == '/') state = SINGLE_COMMENT;
-                else
-                {
-                    // Был оператор деления
-                    state = NORMAL;
-                    // Оператор '/' был проигнорирован, теперь обрабатываем 'c' в NORMAL
-                    char_to_reprocess = c; // Повторно обработаем 'c'
-                    goto process_char_again;
-                }
-                break;
-            // ... остальные case для комментариев/строк ...
-            case MULTI_COMMENT:
-                if (c == '*') state = STAR_IN_MULTI_COMMENT;
-                break;
-            case STAR_IN_MULTI_COMMENT:
-                if (c == '/') state = NORMAL;
-                else if (c != '*') state = MULTI_COMMENT;
-                break;
-            case SINGLE_COMMENT:
-                if (c == '\n' || c == '\r') state = NORMAL;
-                break;
-            case IN_STRING:
-                if (c == '\\') state = SLASH_IN_STRING;
-                else if (c == '"') state = NORMAL;
-                break;
-            case IN_CHAR:
-                if (c == '\\') state = SLASH_IN_CHAR;
-                else if (c == '\'') state = NORMAL;
-                break;
-            case SLASH_IN_STRING:
-                state = IN_STRING;
-                break;
-            case SLASH_IN_CHAR:
-                state = IN_CHAR;
-                break;
-            default:
-                state = NORMAL;
-                break; // На всякий случай
-            }
-            continue; // Пропускаем обработку числа для не-NORMAL состояний
+            threads = static_cast<unsigned>(std::atoi(argv[arg + 1]));
+            arg += 2;
         }
-
-        // --- Обработка символа 'c' в состоянии NORMAL ---
-        if (num_state == IDLE)
+        if (argc - arg < 2)
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+        std::vector<const char*> files(argv + arg + 1, argv + argc);
+        if (frequency_report(argv[arg], files, threads == 0 ? 1 : threads, skip_if0, stats) != 0)
         {
-            saw_digit = false;
-            has_u = false;
-            l_count = 0;
+            return 1;
         }
+        std::cout << "Report generated successfully." << std::endl;
+        return 0;
+    }
 
-        // 1. Обработка состояния INVALID
-        if (num_state == INVALID)
+    if (argc >= 2 && std::string(argv[1]) == "--watch")
+    {
+        long debounce_ms = 5;
+        int arg = 2;
+        if (arg + 1 < argc && std::string(argv[arg]) == "--debounce")
         {
-            if (is_delimiter(c))
-            {
-                // Разделитель завершает ошибочный токен
-                finalize_token(); // Выведет ошибку и сбросит state в IDLE
-                // Разделитель сам по себе игнорируется
-            }
-            else
-            {
-                // Считаем символ продолжением ошибочного токена
-                current_token += c;
-            }
-            continue; // Переходим к следующей итерации
+            debounce_ms = std::strtol(argv[arg + 1], nullptr, 10);
+            arg += 2;
+        }
+        if (argc - arg != 2 || debounce_ms < 0)
+        {
+            print_usage(argv[0]);
+            return 1;
         }
+        if (watch::inside(argv[arg], argv[arg + 1]))
+        {
+            std::cerr << "Report file must not be inside the input directory." << std::endl;
+            return 1;
+        }
+        return watch_report(argv[arg], argv[arg + 1], skip_if0, std::chrono::milliseconds(debounce_ms));
+    }
 
-        // 2. Проверка на завершение ВАЛИДНОГО токена разделителем
-        // (Исключаем NUMBER_END_POTENTIAL_SUFFIX, т.к. там символ - буква)
-        if (num_state != IDLE && num_state != NUMBER_END_POTENTIAL_SUFFIX && is_delimiter(c))
+    if (argc >= 2 && std::string(argv[1]) == "--tar")
+    {
+        if (argc != 4)
         {
-            if (num_state == HEX_START && !saw_digit)
-            {
-                num_state = INVALID;
-            }
-            if (c == '.')
-            {
-                current_token += c; // Добавляем точку к токену
-                num_state = INVALID; // Помечаем токен как ошибочный
-            }
-            finalize_token(); // Завершаем токен, выведет результат
-            // Разделитель сам по себе игнорируется
-            continue; // Переходим к следующей итерации
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (archive_report(argv[2], argv[3], skip_if0, stats) != 0)
+        {
+            return 1;
         }
+        std::cout << "Report generated successfully." << std::endl;
+        return 0;
+    }
 
-        // 4. Основная логика переходов автомата чисел
-        switch (num_state)
+    // Состояние внутри области #if 0 не сохраняется в индексе
+    bool index_mode = argc >= 2
+        && (std::string(argv[1]) == "--index-write" || std::string(argv[1]) == "--range"
+            || std::string(argv[1]) == "--lines");
+    if (skip_if0 && index_mode)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (argc >= 2 && std::string(argv[1]) == "--index-write")
+    {
+        std::uint64_t interval = 1 << 20;
+        int arg = 2;
+        if (arg + 1 < argc && std::string(argv[arg]) == "--interval")
         {
-        case IDLE:
-            if (c == '0')
+            if (!parse_count(argv[arg + 1], interval))
             {
-                num_state = START_ZERO;
-                current_token += c;
+                interval = 0;
             }
-            else if (std::isdigit(c))
-            {
-                num_state = DECIMAL;
-                current_token += c;
-                saw_digit = true;
-            }
-        // Иначе (буква, оператор и т.д.) - игнорируем, остаемся в IDLE
-            break;
+            arg += 2;
+        }
+        if (argc - arg != 2 || interval == 0)
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+        return index_write(argv[arg], argv[arg + 1], interval, stats);
+    }
 
-        case START_ZERO: // Мы прочитали '0'
-            if (c == 'x' || c == 'X')
-            {
-                num_state = HEX_START;
-                current_token += c;
-                saw_digit = false;
-            }
-            else if (c >= '0' && c <= '7')
-            {
-                num_state = OCTAL;
-                current_token += c;
-                saw_digit = true;
-            }
-            else if (c == 'u' || c == 'U')
-            {
-                num_state = SUFFIX_U;
-                current_token += c;
-                has_u = true;
-            }
-            else if (c == 'l' || c == 'L')
-            {
-                num_state = SUFFIX_L;
-                current_token += c;
-                l_count = 1;
-            }
-            else if (is_delimiter(c))
-            {
-                // Завершение токена, finalize_token вызовется выше
-            }
-            else
-            {
-                num_state = INVALID;
-                current_token += c;
-            }
-            break;
+    if (argc >= 2 && (std::string(argv[1]) == "--range" || std::string(argv[1]) == "--lines"))
+    {
+        std::uint64_t from = 0;
+        std::uint64_t to = 0;
+        if (argc != 6 || !parse_range(argv[2], from, to))
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+        bool by_lines = std::string(argv[1]) == "--lines";
+        if (range_report(by_lines, from, to, argv[3], argv[4], argv[5], stats) != 0)
+        {
+            return 1;
+        }
+        std::cout << "Report generated successfully." << std::endl;
+        return 0;
+    }
 
-        case DECIMAL: // Внутри 1..9...
-            if (std::isdigit(c))
-            {
-                current_token += c;
-                saw_digit = true;
-            }
-            else if (c == 'u' || c == 'U')
-            {
-                num_state = SUFFIX_U;
-                current_token += c;
-                has_u = true;
-            }
-            else if (c == 'l' || c == 'L')
-            {
-                num_state = SUFFIX_L;
-                current_token += c;
-                l_count = 1;
-            }
-            else if (is_delimiter(c))
-            {
-                // finalize_token вызовется выше
-            }
-            else
-            {
-                num_state = INVALID;
-                current_token += c;
-            }
-            break;
+    Engine engine = options.engine;
+    bool forced = engine != Engine::AUTO;
+    unsigned threads = std::thread::hardware_concurrency();
+    int arg = 1;
+    if (arg + 1 < argc && std::string(argv[arg]) == "--threads")
+    {
+        // Явное число потоков задает способ
+        threads = static_cast<unsigned>(std::atoi(argv[arg + 1]));
+        engine = threads > 1 ? Engine::PARALLEL : Engine::SCALAR;
+        forced = true;
+        arg += 2;
+    }
+    if (argc - arg != 2)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const char* input_path = argv[arg];
+    const char* report_path = argv[arg + 1];
 
-        case OCTAL: // Внутри 0[0-7]...
-            if (c >= '0' && c <= '7')
-            {
-                current_token += c;
-                saw_digit = true;
-            }
-            else if (c == 'u' || c == 'U')
-            {
-                num_state = SUFFIX_U;
-                current_token += c;
-                has_u = true;
-            }
-            else if (c == 'l' || c == 'L')
-            {
-                num_state = SUFFIX_L;
-                current_token += c;
-                l_count = 1;
-            }
-            else if (is_delimiter(c))
-            {
-                // finalize_token вызовется выше
-            }
-            else
-            {
-                num_state = INVALID;
-                current_token += c;
-            }
-            break;
+    trace::Span file_span("file", input_path);
+    std::string error;
+    std::unique_ptr<io::Input> in;
+    std::unique_ptr<io::Output> report_out;
+    {
+        trace::Span span("open");
+        in = io::open_input(input_path, &error);
+        if (!in)
+        {
+            std::cerr << "Could not open input file: " << error << std::endl;
+            return 1;
+        }
 
-        case HEX_START: // Мы прочитали '0x'
-            if (std::isxdigit(c))
-            {
-                num_state = HEX;
-                current_token += c;
-                saw_digit = true;
-            }
-            else if (is_delimiter(c))
-            {
-                if (!saw_digit)
-                {
-                    num_state = INVALID;
-                }
-                // finalize_token вызовется выше
-            }
-            else
-            {
-                num_state = INVALID;
-                current_token += c;
-            }
-            break;
+        report_out = io::open_output(report_path, &error);
+        if (!report_out)
+        {
+            std::cerr << "Could not open report file: " << error << std::endl;
+            return 1;
+        }
+    }
 
-        case HEX: // Внутри 0x[0-f]...
-            if (std::isxdigit(c))
-            {
-                current_token += c;
-                saw_digit = true;
-            }
-            else if (c == 'u' || c == 'U')
-            {
-                num_state = SUFFIX_U;
-                current_token += c;
-                has_u = true;
-            }
-            else if (c == 'l' || c == 'L')
-            {
-                num_state = SUFFIX_L;
-                current_token += c;
-                l_count = 1;
-            }
-            else if (is_delimiter(c))
-            {
-                // finalize_token вызовется выше
-            }
-            else
-            {
-                num_state = INVALID;
-                current_token += c;
-            }
-            break;
+    // Первый блок - образец для выбора способа; затем он первым уходит
+    // в автомат
+    sample::Profile profile;
+    std::string head;
+    {
+        trace::Span span("read");
+        head = sample::read_head(*in);
+    }
+    std::error_code ec;
+    profile.compressed = in->compression() != io::Compression::NONE;
+    // У сжатого файла размер на диске ничего не говорит о размере входа
+    if (!profile.compressed && std::filesystem::is_regular_file(input_path, ec))
+    {
+        profile.size = std::filesystem::file_size(input_path, ec);
+        profile.mappable = true;
+    }
+    sample::measure(head, profile);
+    if (engine == Engine::AUTO)
+    {
+        engine = choose_engine(profile, skip_if0, threads);
+    }
 
-        // ---> Обработка буквы после числа <---
-        case NUMBER_END_POTENTIAL_SUFFIX:
-            // ---> Обработка буквы после числа <---
-            // 'potential_suffix_char' содержит букву, прочитанную на пред. шаге ('a')
-            // 'c' - это символ, идущий ПОСЛЕ этой буквы (например, разделитель)
-            {
-                char first_letter = potential_suffix_char; // 'a'
-                char first_letter_lower = tolower(first_letter);
-                potential_suffix_char = 0; // Сбрасываем
+    // Параллельный разбор возможен только для несжатого обычного файла
+    // и без пропуска #if 0 (склейка частей знает только внешнее состояние)
+    io::MappedFile mapped(engine == Engine::PARALLEL ? input_path : "");
+    if (engine == Engine::PARALLEL && (threads < 2 || skip_if0 || !mapped.valid()))
+    {
+        engine = Engine::SCALAR;
+    }
+    if (options.log_engine)
+    {
+        std::cerr << "engine: " << engine_names[static_cast<int>(engine)];
+        if (engine == Engine::PARALLEL)
+        {
+            std::cerr << " x" << threads;
+        }
+        std::cerr << (forced ? " (forced)" : "") << " for " << input_path
+                  << " (" << profile.describe() << ")" << std::endl;
+    }
 
-                if (first_letter_lower == 'u')
-                {
-                    current_token += first_letter; // Добавляем 'u' к токену "12" -> "12u"
-                    num_state = SUFFIX_U; // Переходим в состояние суффикса
-                    char_to_reprocess = c; // Повторно обработаем 'c'
-                    goto process_char_again;
-                }
-                if (first_letter_lower == 'l')
-                {
-                    current_token += first_letter; // Добавляем 'l' к токену "12" -> "12l"
-                    num_state = SUFFIX_L;
-                    char_to_reprocess = c;
-                    goto process_char_again;
-                }
-                // Буква была не 'u' и не 'l'. Это ошибка для целочисленной константы.
-                current_token += first_letter; // Добавляем 'a' к токену "12" -> "12a"
-                num_state = INVALID; // Переходим в состояние ошибки
-                char_to_reprocess = c; // Повторно обработаем 'c' в состоянии INVALID
-                // (скорее всего, 'c' будет разделителем и вызовет finalize)
-                goto process_char_again;
-            }
-        // Конец case NUMBER_END_POTENTIAL_SUFFIX
+    // В конвейере запись идет в своем потоке и в замеры не попадает
+    trace::WriteSpans write_spans(engine == Engine::PIPELINE ? nullptr : stats);
+    report_out->set_observer(&write_spans);
+    sample::Prefixed<io::Input> source(head, *in);
+    if (engine == Engine::PARALLEL)
+    {
+        if (stats)
+        {
+            stats->add_input(mapped.data().size());
+        }
+        parallel_report(mapped.data(), threads, *report_out);
+    }
+    else if (engine == Engine::PIPELINE)
+    {
+        pipeline::Pipeline<sample::Prefixed<io::Input>> pipe(source, *report_out);
+        auto handler = [&pipe](const Literal& lit)
+        {
+            write_line(pipe.sink(), {lit.text, lit.type});
+        };
+        Scanner<decltype(handler)> scanner(handler);
+        scanner.set_skip_disabled(skip_if0);
+        std::string_view chunk;
+        while (pipe.next(chunk))
+        {
+            scanner.feed(chunk);
+        }
+        scanner.finish();
+        pipe.finish();
+        if (stats)
+        {
+            stats->add_input(pipe.input_bytes());
+        }
+    }
+    else
+    {
+        perf::TimedInput<sample::Prefixed<io::Input>> timed_in(source, stats);
+        trace::TracedInput<perf::TimedInput<sample::Prefixed<io::Input>>> traced_in(timed_in);
+        scan_stream(traced_in, [&](const Literal& lit)
+        {
+            write_line(*report_out, {lit.text, lit.type});
+        }, skip_if0);
+    }
 
-        // ---> Обработка состояний суффикса <---
-        case SUFFIX_U: // Прочитали ...u
-            if (c == 'l' || c == 'L')
-            {
-                if (l_count == 0)
-                {
-                    num_state = SUFFIX_UL;
-                    current_token += c;
-                    l_count = 1;
-                }
-                else
-                {
-                    num_state = INVALID;
-                    current_token += c;
-                }
-            }
-            else if (is_delimiter(c))
-            {
-                // finalize_token вызовется выше
-            }
-            else
-            {
-                num_state = INVALID;
-                current_token += c;
-            }
-            break;
+    if (!in->error().empty())
+    {
+        std::cerr << "Could not read input file: " << in->error() << std::endl;
+        return 1;
+    }
+    if (!report_out->close())
+    {
+        std::cerr << "Could not write report file: " << report_out->error() << std::endl;
+        return 1;
+    }
 
-        case SUFFIX_L: // Прочитали ...l
-            if (c == 'l' || c == 'L')
-            {
-                if (l_count == 1)
-                {
-                    num_state = SUFFIX_LL;
-                    current_token += c;
-                    l_count = 2;
-                }
-                else
-                {
-                    num_state = INVALID;
-                    current_token += c;
-                }
-            }
-            else if (c == 'u' || c == 'U')
-            {
-                if (!has_u)
-                {
-                    num_state = SUFFIX_UL;
-                    current_token += c;
-                    has_u = true;
-                }
-                else
-                {
-                    num_state = INVALID;
-                    current_token += c;
-                }
-            }
-            else if (is_delimiter(c))
-            {
-                // finalize_token вызовется выше
-            }
-            else
-            {
-                num_state = INVALID;
-                current_token += c;
-            }
-            break;
+    std::cout << "Report generated successfully." << std::endl; // Сообщение пользователю
 
-        case SUFFIX_LL: // Прочитали ...ll
-            if (c == 'u' || c == 'U')
-            {
-                if (!has_u)
-                {
-                    num_state = SUFFIX_ULL;
-                    current_token += c;
-                    has_u = true;
-                }
-                else
-                {
-                    num_state = INVALID;
-                    current_token += c;
-                }
-            }
-            else if (is_delimiter(c))
-            {
-                // finalize_token вызовется выше
-            }
-            else
-            {
-                num_state = INVALID;
-                current_token += c;
-            }
-            break;
+    return 0;
+}
 
-        case SUFFIX_UL: // Прочитали ...ul или ...lu
-            // После ul/lu разрешён только разделитель или один дополнительный l (чтобы получить строго ull/llu), но не ul*l* или lu*l*
-            if (c == 'l' || c == 'L')
+int main(int argc, char* argv[])
+{
+    perf::Format perf_format = perf::Format::NONE;
+    Options options;
+    std::string trace_path;
+    while (argc >= 2)
+    {
+        std::string option = argv[1];
+        int used = 1;
+        if (option == "--skip-if0")
+        {
+            options.skip_if0 = true;
+        }
+        else if (option == "--pipeline")
+        {
+            options.engine = Engine::PIPELINE;
+        }
+        else if (option == "--log-engine")
+        {
+            options.log_engine = true;
+        }
+        else if (option.rfind("--engine=", 0) == 0)
+        {
+            std::string name = option.substr(9);
+            int found = -1;
+            for (int i = 0; i < 4; ++i)
             {
-                // Если уже был l_count == 1 (ul/lu), то ещё один l даёт ull/llu (l_count == 2), но запрещаем больше l
-                if (l_count == 1 && !has_u)
+                if (name == engine_names[i])
                 {
-                    num_state = SUFFIX_ULL;
-                    current_token += c;
-                    l_count = 2;
+                    found = i;
                 }
-                else
-                {
-                    num_state = INVALID;
-                    current_token += c;
-                }
-            }
-            else if (is_delimiter(c))
-            {
-                // finalize_token вызовется выше
             }
-            else
+            if (found < 0)
             {
-                num_state = INVALID;
-                current_token += c;
-            }
-            break;
-
-        case SUFFIX_ULL: // Прочитали ...ull или ...llu
-            if (is_delimiter(c))
-            {
-                // finalize_token вызовется выше
-            }
-            else
-            {
-                num_state = INVALID;
-                current_token += c;
+                print_usage(argv[0]);
+                return 1;
             }
+            options.engine = static_cast<Engine>(found);
+        }
+        else if (option == "--trace" && argc >= 3)
+        {
+            trace_path = argv[2];
+            used = 2;
+        }
+        else if (!perf::parse_option(option, perf_format))
+        {
             break;
-        } // Конец switch(num_state)
-    } // Конец while(in.get(c))
-
-    // Финализация последнего токена после выхода из цикла
-    finalize_token();
-
-    in.close();
-    report_out.close();
+        }
+        // Общие параметры убираются, дальше разбираются параметры режима
+        argv[used] = argv[0];
+        argv += used;
+        argc -= used;
+    }
+    if (!trace_path.empty() && argc >= 2 && std::string(argv[1]) == "--watch")
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
 
-    std::cout << "Report generated successfully." << std::endl; // Сообщение пользователю
+    // Создаются раньше выходов, чтобы пережить их
+    std::unique_ptr<trace::Recorder> tracer;
+    if (!trace_path.empty())
+    {
+        tracer = std::make_unique<trace::Recorder>();
+    }
+    std::unique_ptr<perf::Stats> stats;
+    if (perf_format != perf::Format::NONE)
+    {
+        stats = std::make_unique<perf::Stats>();
+    }
 
-    return 0;
+    // В JSON-замерах stderr остается разбираемым, если не задан --log-engine
+    options.log_engine = options.log_engine || perf_format == perf::Format::TEXT;
+    int status = run(argc, argv, options, stats.get());
+    std::string error;
+    if (tracer && !tracer->write(trace_path, &error))
+    {
+        std::cerr << "Could not write trace file: " << error << std::endl;
+        status = 1;
+    }
+    if (stats && status == 0)
+    {
+        stats->report(std::cerr, perf_format);
+    }
+    return status;
 }
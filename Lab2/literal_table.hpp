@@ -0,0 +1,151 @@
+#pragma once
+
+// Таблица различных написаний констант с числом вхождений.
+// Каждое написание хранится один раз в арене; таблица разбита на
+// полосы со своими мьютексами, поэтому потоки могут добавлять в нее
+// константы одновременно, почти не мешая друг другу.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Место в исходных файлах: номер файла в списке, строка, смещение
+struct Location
+{
+    std::uint32_t file;
+    std::uint64_t line;
+    std::uint64_t offset;
+};
+
+inline bool operator<(const Location& a, const Location& b)
+{
+    return a.file != b.file ? a.file < b.file : a.offset < b.offset;
+}
+
+struct LiteralStats
+{
+    std::string_view text;
+    const char* type;
+    std::uint64_t count;
+    Location first; // самое раннее вхождение
+};
+
+// Арена строк: копии живут, пока жива арена
+class Arena
+{
+public:
+    std::string_view store(std::string_view s)
+    {
+        if (s.size() > capacity - used)
+        {
+            capacity = std::max(block_size, s.size());
+            blocks.push_back(std::make_unique<char[]>(capacity));
+            used = 0;
+        }
+        char* dst = blocks.back().get() + used;
+        std::memcpy(dst, s.data(), s.size());
+        used += s.size();
+        return {dst, s.size()};
+    }
+
+private:
+    static constexpr std::size_t block_size = 1 << 16;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::size_t used = 0;
+    std::size_t capacity = 0;
+};
+
+// Однопоточная таблица: накапливает вхождения внутри одного файла
+class LocalLiteralTable
+{
+public:
+    void add(std::string_view text, const char* type, const Location& where)
+    {
+        auto it = map.find(text);
+        if (it == map.end())
+        {
+            std::string_view key = arena.store(text);
+            map.emplace(key, LiteralStats{key, type, 1, where});
+            return;
+        }
+        ++it->second.count;
+    }
+
+    template <class F>
+    void for_each(F f) const
+    {
+        for (const auto& entry : map)
+        {
+            f(entry.second);
+        }
+    }
+
+private:
+    Arena arena;
+    std::unordered_map<std::string_view, LiteralStats> map;
+};
+
+// Общая таблица для всех потоков
+class LiteralTable
+{
+public:
+    void add(const LiteralStats& stats)
+    {
+        const std::size_t hash = std::hash<std::string_view>{}(stats.text);
+        Stripe& stripe = stripes[hash % stripe_count];
+
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto it = stripe.map.find(stats.text);
+        if (it == stripe.map.end())
+        {
+            LiteralStats copy = stats;
+            copy.text = stripe.arena.store(stats.text);
+            stripe.map.emplace(copy.text, copy);
+            return;
+        }
+        it->second.count += stats.count;
+        if (stats.first < it->second.first)
+        {
+            it->second.first = stats.first;
+        }
+    }
+
+    // Все записи по убыванию частоты (при равенстве - по написанию).
+    // Вызывается после завершения всех потоков.
+    std::vector<LiteralStats> sorted() const
+    {
+        std::vector<LiteralStats> result;
+        for (const Stripe& stripe : stripes)
+        {
+            for (const auto& entry : stripe.map)
+            {
+                result.push_back(entry.second);
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const LiteralStats& a, const LiteralStats& b)
+        {
+            return a.count != b.count ? a.count > b.count : a.text < b.text;
+        });
+        return result;
+    }
+
+private:
+    static constexpr std::size_t stripe_count = 64;
+
+    struct Stripe
+    {
+        std::mutex mutex;
+        Arena arena;
+        std::unordered_map<std::string_view, LiteralStats> map;
+    };
+
+    std::array<Stripe, stripe_count> stripes;
+};
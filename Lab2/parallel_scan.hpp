@@ -0,0 +1,193 @@
+#pragma once
+
+// Параллельный разбор Lab2 по частям файла.
+// Границы частей ставятся сразу после '\n': перевод строки всегда
+// завершает токен, поэтому на границе полное состояние автомата сводится
+// к внешнему State (NORMAL, MULTI_COMMENT, IN_STRING или IN_CHAR), а
+// константа не может пересечь границу. Каждая часть разбирается в своем
+// потоке в предположении, что она начинается в NORMAL. При склейке по
+// порядку часть, которая на самом деле начинается в другом состоянии,
+// разбирается заново с настоящего состояния до первой строки, на которой
+// состояния совпали; дальше берется уже готовый результат.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../common/io.hpp"
+#include "../common/trace.hpp"
+#include "scanner.hpp"
+
+struct ChunkResult
+{
+    std::string report; // строки отчета "константа\tтип\n"
+    std::vector<std::uint64_t> literal_offsets; // смещения констант в порядке строк отчета
+    std::vector<std::pair<std::uint64_t, State>> odd_lines; // начала строк, где State != NORMAL
+    State end_state = NORMAL;
+};
+
+inline void append_literal(std::string& report, const Literal& lit)
+{
+    report.append(lit.text.data(), lit.text.size());
+    report += '\t';
+    report += lit.type;
+    report += '\n';
+}
+
+// Кормит автомат по строкам; at_line_start(смещение) вызывается в начале
+// каждой следующей строки и может остановить разбор, вернув true
+template <class S, class F>
+void feed_lines(S& scanner, std::string_view data, std::uint64_t base, F at_line_start)
+{
+    std::size_t pos = 0;
+    while (pos < data.size())
+    {
+        const void* nl = std::memchr(data.data() + pos, '\n', data.size() - pos);
+        std::size_t next = nl ? static_cast<std::size_t>(static_cast<const char*>(nl) - data.data()) + 1 : data.size();
+        scanner.feed(data.substr(pos, next - pos));
+        pos = next;
+        if (nl && at_line_start(base + pos))
+        {
+            return;
+        }
+    }
+}
+
+// Разбор части в предположении, что она начинается в NORMAL
+inline ChunkResult scan_chunk(std::string_view data, std::uint64_t base)
+{
+    ChunkResult r;
+    auto handler = [&r](const Literal& lit)
+    {
+        r.literal_offsets.push_back(lit.offset);
+        append_literal(r.report, lit);
+    };
+    Scanner<decltype(handler)> scanner(handler);
+    ScannerState start;
+    start.offset = base;
+    scanner.restore(start);
+
+    feed_lines(scanner, data, base, [&](std::uint64_t line_start)
+    {
+        if (scanner.outer_state() != NORMAL)
+        {
+            r.odd_lines.emplace_back(line_start, scanner.outer_state());
+        }
+        return false;
+    });
+    scanner.finish();
+    r.end_state = scanner.outer_state();
+    return r;
+}
+
+// Повторный разбор части с настоящего состояния entry до сходимости
+// с предположительным разбором
+inline void repair_chunk(ChunkResult& r, std::string_view data, std::uint64_t base, State entry)
+{
+    std::string report;
+    auto handler = [&report](const Literal& lit) { append_literal(report, lit); };
+    Scanner<decltype(handler)> scanner(handler);
+    ScannerState start;
+    start.state = entry;
+    start.offset = base;
+    scanner.restore(start);
+
+    auto speculative_state = [&](std::uint64_t line_start)
+    {
+        auto it = std::lower_bound(r.odd_lines.begin(), r.odd_lines.end(), std::make_pair(line_start, NORMAL));
+        return it != r.odd_lines.end() && it->first == line_start ? it->second : NORMAL;
+    };
+
+    bool converged = false;
+    std::uint64_t converged_at = 0;
+    feed_lines(scanner, data, base, [&](std::uint64_t line_start)
+    {
+        converged = scanner.outer_state() == speculative_state(line_start);
+        converged_at = line_start;
+        return converged;
+    });
+
+    if (!converged)
+    {
+        scanner.finish();
+        r.report = std::move(report);
+        r.end_state = scanner.outer_state();
+        return;
+    }
+
+    // С точки сходимости строки отчета предположительного разбора верны
+    auto kept = std::lower_bound(r.literal_offsets.begin(), r.literal_offsets.end(), converged_at);
+    std::size_t skip = static_cast<std::size_t>(kept - r.literal_offsets.begin());
+    std::size_t cut = 0;
+    for (std::size_t i = 0; i < skip; ++i)
+    {
+        cut = r.report.find('\n', cut) + 1;
+    }
+    report.append(r.report, cut, std::string::npos);
+    r.report = std::move(report);
+}
+
+// Отчет, совпадающий с последовательным разбором data
+inline void parallel_report(std::string_view data, unsigned threads, io::Output& out)
+{
+    // Несколько частей на поток - для выравнивания нагрузки
+    const std::size_t parts = static_cast<std::size_t>(threads) * 4;
+    std::vector<std::size_t> bounds{0};
+    for (std::size_t i = 1; i < parts; ++i)
+    {
+        std::size_t target = std::max(data.size() / parts * i, bounds.back());
+        const void* nl = std::memchr(data.data() + target, '\n', data.size() - target);
+        if (!nl)
+        {
+            break;
+        }
+        std::size_t bound = static_cast<std::size_t>(static_cast<const char*>(nl) - data.data()) + 1;
+        if (bound > bounds.back() && bound < data.size())
+        {
+            bounds.push_back(bound);
+        }
+    }
+    bounds.push_back(data.size());
+
+    const std::size_t count = bounds.size() - 1;
+    std::vector<ChunkResult> results(count);
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]()
+    {
+        for (std::size_t i = next++; i < count; i = next++)
+        {
+            trace::Span span("chunk");
+            results[i] = scan_chunk(data.substr(bounds[i], bounds[i + 1] - bounds[i]), bounds[i]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : pool)
+    {
+        t.join();
+    }
+
+    // Склейка по порядку
+    State entry = NORMAL;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (entry != NORMAL)
+        {
+            trace::Span span("repair");
+            repair_chunk(results[i], data.substr(bounds[i], bounds[i + 1] - bounds[i]), bounds[i], entry);
+        }
+        out.write(results[i].report.data(), results[i].report.size());
+        entry = results[i].end_state;
+        results[i] = ChunkResult();
+    }
+}
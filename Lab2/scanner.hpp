@@ -0,0 +1,819 @@
+#pragma once
+
+// Автомат распознавания целых констант Lab2 в виде класса, который можно
+// кормить блоками: внешний автомат (комментарии, строки) и внутренний
+// (числа) сохраняют состояние между вызовами feed. По желанию внешний
+// автомат пропускает области #if 0, не разбирая их (pp_skip.hpp).
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "../common/pp_skip.hpp"
+#include "../common/simd.hpp"
+
+// Состояния внешнего автомата (комментарии, строки)
+enum State
+{
+    NORMAL,
+    SLASH,
+    MULTI_COMMENT,
+    STAR_IN_MULTI_COMMENT,
+    SINGLE_COMMENT,
+    IN_STRING,
+    IN_CHAR,
+    SLASH_IN_STRING,
+    SLASH_IN_CHAR,
+    DIRECTIVE, // начало директивы на границе блоков
+    DISABLED // внутри #if 0
+};
+
+// Состояния внутреннего автомата для распознавания чисел
+enum NumberState
+{
+    IDLE, // Начальное состояние (не число)
+    START_ZERO, // Встретили '0'
+    OCTAL, // Внутри восьмеричного числа (после '0')
+    DECIMAL, // Внутри десятичного числа
+    HEX_START, // Встретили '0x' или '0X'
+    HEX, // Внутри шестнадцатеричного числа
+    NUMBER_END_POTENTIAL_SUFFIX, // Числовая часть закончилась, след. символ - буква
+    SUFFIX_U, // Встретили 'u' в суффиксе
+    SUFFIX_L, // Встретили 'l' в суффиксе
+    SUFFIX_LL, // Встретили 'll' в суффиксе
+    SUFFIX_UL, // Встретили 'ul' или 'lu'
+    SUFFIX_ULL, // Встретили 'ull' или 'llu'
+    INVALID // Недопустимая последовательность
+};
+
+// Функция для определения типа константы по суффиксам
+// (l_count: 0 для нет 'l', 1 для 'l', 2 для 'll')
+inline const char* get_int_type(bool has_u, int l_count)
+{
+    if (has_u)
+    {
+        if (l_count == 0) return "unsigned int";
+        if (l_count == 1) return "unsigned long";
+        return "unsigned long long"; // l_count = 2
+    }
+    if (l_count == 0) return "int"; // Тип по умолчанию
+    if (l_count == 1) return "long";
+    return "long long"; // l_count = 2
+}
+
+// Функция для проверки, является ли символ разделителем (завершает токен)
+inline bool is_delimiter(char c)
+{
+    return std::isspace(c) || std::string("+-*/%=(){}[];,<>&|^!~?#:").find(c) != std::string::npos;
+}
+
+// Распознанная константа
+struct Literal
+{
+    std::string_view text; // написание константы
+    const char* type; // тип константы или "ERROR"
+    std::uint64_t offset; // смещение первого символа от начала входа
+    std::uint64_t line; // номер строки (с 1)
+};
+
+// Полное состояние автомата в точке входа: из него разбор можно
+// продолжить с того же места (см. Scanner::save/restore)
+struct ScannerState
+{
+    State state = NORMAL;
+    NumberState num_state = IDLE;
+    std::string current_token;
+    char potential_suffix_char = 0;
+    bool has_u = false;
+    int l_count = 0;
+    bool saw_digit = false;
+    std::uint64_t offset = 0;
+    std::uint64_t line = 1;
+    std::uint64_t token_offset = 0;
+    std::uint64_t token_line = 0;
+};
+
+// Handler вызывается для каждой константы: handler(const Literal&)
+template <class Handler>
+class Scanner
+{
+public:
+    explicit Scanner(Handler handler) : handler(std::move(handler))
+    {
+    }
+
+    // Разбор очередного блока входа
+    void feed(std::string_view chunk);
+
+    // Конец входа: финализация последнего токена
+    void finish()
+    {
+        if (state == DIRECTIVE)
+        {
+            finish_directive();
+        }
+        finalize_token();
+    }
+
+    // Пропуск областей #if 0. Состояние внутри области не сохраняется
+    // в ScannerState, поэтому режим несовместим с индексом и параллельным
+    // разбором.
+    void set_skip_disabled(bool on)
+    {
+        skip_disabled = on;
+    }
+
+    ScannerState save() const
+    {
+        return ScannerState{state, num_state, current_token, potential_suffix_char, has_u, l_count,
+                            saw_digit, offset, line, token_offset, token_line};
+    }
+
+    void restore(const ScannerState& s)
+    {
+        state = s.state;
+        num_state = s.num_state;
+        current_token = s.current_token;
+        potential_suffix_char = s.potential_suffix_char;
+        has_u = s.has_u;
+        l_count = s.l_count;
+        saw_digit = s.saw_digit;
+        offset = s.offset;
+        line = s.line;
+        token_offset = s.token_offset;
+        token_line = s.token_line;
+    }
+
+    // Есть ли незавершенный токен
+    bool in_token() const
+    {
+        return !current_token.empty();
+    }
+
+    State outer_state() const
+    {
+        return state;
+    }
+
+    // Смещение следующего непрочитанного символа
+    std::uint64_t current_offset() const
+    {
+        return offset;
+    }
+
+    std::uint64_t current_line() const
+    {
+        return line;
+    }
+
+private:
+    void finalize_token();
+    const char* held_directive(const char* p, const char* end);
+    void finish_directive();
+    void replay(std::string text);
+
+    Handler handler;
+
+    State state = NORMAL;
+    NumberState num_state = IDLE;
+    std::string current_token;
+    // Символ, сохраненный для проверки на принадлежность к суффиксу
+    char potential_suffix_char = 0;
+    bool has_u = false;
+    int l_count = 0;
+    bool saw_digit = false;
+
+    // Позиция: смещение начала текущего блока и номер текущей строки
+    std::uint64_t offset = 0;
+    std::uint64_t line = 1;
+    // Позиция первого символа текущего токена
+    std::uint64_t token_offset = 0;
+    std::uint64_t token_line = 0;
+
+    // Для областей #if 0
+    bool skip_disabled = false;
+    pp::Skipper skipper;
+    std::string held; // начало директивы из прошлых блоков
+    bool blank_tail = true; // строка до текущего блока состоит из пробелов
+};
+
+// Вызывается ПЕРЕД обработкой символа, который ЗАВЕРШАЕТ токен
+template <class Handler>
+void Scanner<Handler>::finalize_token()
+{
+    if (current_token.empty())
+    {
+        // Не выводим ничего для пустого токена
+        num_state = IDLE;
+        potential_suffix_char = 0;
+        has_u = false;
+        l_count = 0;
+        saw_digit = false;
+        return;
+    }
+    // Если автомат в состоянии INVALID, это точно ошибка,
+    // иначе автомат уже определил тип и валидность
+    const char* type = num_state == INVALID ? "ERROR" : get_int_type(has_u, l_count);
+    handler(Literal{current_token, type, token_offset, token_line});
+
+    // --- Сброс состояния и токена в конце финализации ---
+    current_token.clear();
+    num_state = IDLE;
+    potential_suffix_char = 0;
+    has_u = false;
+    l_count = 0;
+    saw_digit = false;
+}
+
+// Продолжение директивы, начатой в прошлых блоках
+template <class Handler>
+const char* Scanner<Handler>::held_directive(const char* p, const char* end)
+{
+    std::string head = held;
+    head.append(p, std::min<std::size_t>(end - p, pp::head_limit));
+    std::size_t length = 0;
+    pp::Directive d = pp::classify(head, &length);
+    if (d == pp::INCOMPLETE)
+    {
+        held = head;
+        return end;
+    }
+    std::string text = std::move(held);
+    held.clear();
+    state = NORMAL;
+    if (d == pp::IF_ZERO)
+    {
+        skipper.start();
+        state = DISABLED;
+        return p + (length > text.size() ? length - text.size() : 0);
+    }
+    replay(std::move(text));
+    return p;
+}
+
+// Отложенное начало директивы в конце входа
+template <class Handler>
+void Scanner<Handler>::finish_directive()
+{
+    std::size_t length = 0;
+    state = NORMAL;
+    if (pp::classify(held + '\n', &length) != pp::IF_ZERO)
+    {
+        replay(std::move(held));
+    }
+    held.clear();
+}
+
+// Разбор отложенного текста обычным путем, как будто он стоит прямо
+// перед текущим блоком (переводов строк в нем нет)
+template <class Handler>
+void Scanner<Handler>::replay(std::string text)
+{
+    offset -= text.size();
+    skip_disabled = false;
+    feed(text); // вернет offset на место
+    skip_disabled = true;
+}
+
+template <class Handler>
+void Scanner<Handler>::feed(std::string_view chunk)
+{
+    const char* begin = chunk.data();
+    const char* p = begin;
+    const char* end = p + chunk.size();
+    char c;
+
+    while (p != end)
+    {
+        // Области #if 0 пропускаются целиком, считаются только строки
+        if (state == DIRECTIVE || state == DISABLED)
+        {
+            const char* from = p;
+            if (state == DIRECTIVE)
+            {
+                p = held_directive(p, end);
+            }
+            else
+            {
+                pp::Skipper::End result;
+                p = skipper.scan(begin, p, end, blank_tail, result);
+                if (result != pp::Skipper::MORE)
+                {
+                    state = NORMAL;
+                }
+            }
+            line += std::count(from, p, '\n');
+            continue;
+        }
+
+        c = *p++;
+        if (c == '\n')
+        {
+            ++line;
+        }
+        // Вспомогательная переменная для повторной обработки символа
+        char char_to_reprocess = 0;
+
+    process_char_again: // Метка для повторной обработки
+
+        // Если есть символ для повторной обработки, используем его
+        if (char_to_reprocess != 0)
+        {
+            c = char_to_reprocess;
+        }
+
+        // 0. Обработка смены основного состояния (комментарии, строки)
+        if (state == NORMAL)
+        {
+            // Проверяем, не начинается ли комментарий или строка
+            if (c == '/')
+            {
+                // Может быть комментарий ИЛИ завершение числа перед оператором
+                finalize_token(); // Завершаем предыдущий токен (если был)
+                state = SLASH; // Переходим в состояние проверки '/'
+                continue; // Переходим к след. итерации для обработки '/' в SLASH
+            }
+            if (c == '"')
+            {
+                finalize_token();
+                state = IN_STRING;
+                continue;
+            }
+            if (c == '\'')
+            {
+                finalize_token();
+                state = IN_CHAR;
+                continue;
+            }
+            // '#' в начале строки: #if 0 открывает пропускаемую область.
+            // Токена перед ним нет - его завершил перевод строки.
+            if (c == '#' && skip_disabled && pp::directive_start(begin, p - 1, blank_tail))
+            {
+                std::size_t length = 0;
+                pp::Directive d = pp::classify({p - 1, static_cast<std::size_t>(end - p + 1)}, &length);
+                if (d == pp::INCOMPLETE)
+                {
+                    held.assign(p - 1, end);
+                    state = DIRECTIVE;
+                    p = end;
+                    continue;
+                }
+                if (d == pp::IF_ZERO)
+                {
+                    skipper.start();
+                    state = DISABLED;
+                    p = p - 1 + length;
+                    continue;
+                }
+            }
+            // Если это не начало комм/строки, остаемся в NORMAL
+        }
+        else
+        {
+            // Мы НЕ в NORMAL, обрабатываем комментарии/строки и т.д.
+            // (Логика как в Лаб 1, но без вывода символов)
+            switch (state)
+            {
+            case SLASH:
+                if (c == '*') state = MULTI_COMMENT;
+                else if (c == '/') state = SINGLE_COMMENT;
+                else
+                {
+                    // Был оператор деления
+                    state = NORMAL;
+                    // Оператор '/' был проигнорирован, теперь обрабатываем 'c' в NORMAL
+                    char_to_reprocess = c; // Повторно обработаем 'c'
+                    goto process_char_again;
+                }
+                break;
+            // ... остальные case для комментариев/строк ...
+            case MULTI_COMMENT:
+                if (c == '*') state = STAR_IN_MULTI_COMMENT;
+                break;
+            case STAR_IN_MULTI_COMMENT:
+                if (c == '/') state = NORMAL;
+                else if (c != '*') state = MULTI_COMMENT;
+                break;
+            case SINGLE_COMMENT:
+                if (c == '\n' || c == '\r') state = NORMAL;
+                break;
+            case IN_STRING:
+                if (c == '\\') state = SLASH_IN_STRING;
+                else if (c == '"') state = NORMAL;
+                break;
+            case IN_CHAR:
+                if (c == '\\') state = SLASH_IN_CHAR;
+                else if (c == '\'') state = NORMAL;
+                break;
+            case SLASH_IN_STRING:
+                state = IN_STRING;
+                break;
+            case SLASH_IN_CHAR:
+                state = IN_CHAR;
+                break;
+            default:
+                state = NORMAL;
+                break; // На всякий случай
+            }
+            continue; // Пропускаем обработку числа для не-NORMAL состояний
+        }
+
+        // --- Обработка символа 'c' в состоянии NORMAL ---
+        if (num_state == IDLE)
+        {
+            saw_digit = false;
+            has_u = false;
+            l_count = 0;
+        }
+
+        // 1. Обработка состояния INVALID
+        if (num_state == INVALID)
+        {
+            if (is_delimiter(c))
+            {
+                // Разделитель завершает ошибочный токен
+                finalize_token(); // Выведет ошибку и сбросит state в IDLE
+                // Разделитель сам по себе игнорируется
+            }
+            else
+            {
+                // Считаем символ продолжением ошибочного токена
+                current_token += c;
+            }
+            continue; // Переходим к следующей итерации
+        }
+
+        // 2. Проверка на завершение ВАЛИДНОГО токена разделителем
+        // (Исключаем NUMBER_END_POTENTIAL_SUFFIX, т.к. там символ - буква)
+        if (num_state != IDLE && num_state != NUMBER_END_POTENTIAL_SUFFIX && is_delimiter(c))
+        {
+            if (num_state == HEX_START && !saw_digit)
+            {
+                num_state = INVALID;
+            }
+            if (c == '.')
+            {
+                current_token += c; // Добавляем точку к токену
+                num_state = INVALID; // Помечаем токен как ошибочный
+            }
+            finalize_token(); // Завершаем токен, выведет результат
+            // Разделитель сам по себе игнорируется
+            continue; // Переходим к следующей итерации
+        }
+
+        // 4. Основная логика переходов автомата чисел
+        switch (num_state)
+        {
+        case IDLE:
+            if (std::isdigit(c))
+            {
+                // Начало нового токена
+                token_offset = offset + (p - 1 - begin);
+                token_line = line;
+            }
+            if (c == '0')
+            {
+                num_state = START_ZERO;
+                current_token += c;
+            }
+            else if (std::isdigit(c))
+            {
+                num_state = DECIMAL;
+                current_token += c;
+                saw_digit = true;
+            }
+        // Иначе (буква, оператор и т.д.) - игнорируем, остаемся в IDLE
+            break;
+
+        case START_ZERO: // Мы прочитали '0'
+            if (c == 'x' || c == 'X')
+            {
+                num_state = HEX_START;
+                current_token += c;
+                saw_digit = false;
+            }
+            else if (c >= '0' && c <= '7')
+            {
+                num_state = OCTAL;
+                current_token += c;
+                saw_digit = true;
+            }
+            else if (c == 'u' || c == 'U')
+            {
+                num_state = SUFFIX_U;
+                current_token += c;
+                has_u = true;
+            }
+            else if (c == 'l' || c == 'L')
+            {
+                num_state = SUFFIX_L;
+                current_token += c;
+                l_count = 1;
+            }
+            else if (is_delimiter(c))
+            {
+                // Завершение токена, finalize_token вызовется выше
+            }
+            else
+            {
+                num_state = INVALID;
+                current_token += c;
+            }
+            break;
+
+        case DECIMAL: // Внутри 1..9...
+            if (std::isdigit(c))
+            {
+                current_token += c;
+                saw_digit = true;
+            }
+            else if (c == 'u' || c == 'U')
+            {
+                num_state = SUFFIX_U;
+                current_token += c;
+                has_u = true;
+            }
+            else if (c == 'l' || c == 'L')
+            {
+                num_state = SUFFIX_L;
+                current_token += c;
+                l_count = 1;
+            }
+            else if (is_delimiter(c))
+            {
+                // finalize_token вызовется выше
+            }
+            else
+            {
+                num_state = INVALID;
+                current_token += c;
+            }
+            break;
+
+        case OCTAL: // Внутри 0[0-7]...
+            if (c >= '0' && c <= '7')
+            {
+                current_token += c;
+                saw_digit = true;
+            }
+            else if (c == 'u' || c == 'U')
+            {
+                num_state = SUFFIX_U;
+                current_token += c;
+                has_u = true;
+            }
+            else if (c == 'l' || c == 'L')
+            {
+                num_state = SUFFIX_L;
+                current_token += c;
+                l_count = 1;
+            }
+            else if (is_delimiter(c))
+            {
+                // finalize_token вызовется выше
+            }
+            else
+            {
+                num_state = INVALID;
+                current_token += c;
+            }
+            break;
+
+        case HEX_START: // Мы прочитали '0x'
+            if (std::isxdigit(c))
+            {
+                num_state = HEX;
+                current_token += c;
+                saw_digit = true;
+            }
+            else if (is_delimiter(c))
+            {
+                if (!saw_digit)
+                {
+                    num_state = INVALID;
+                }
+                // finalize_token вызовется выше
+            }
+            else
+            {
+                num_state = INVALID;
+                current_token += c;
+            }
+            break;
+
+        case HEX: // Внутри 0x[0-f]...
+            if (std::isxdigit(c))
+            {
+                current_token += c;
+                saw_digit = true;
+            }
+            else if (c == 'u' || c == 'U')
+            {
+                num_state = SUFFIX_U;
+                current_token += c;
+                has_u = true;
+            }
+            else if (c == 'l' || c == 'L')
+            {
+                num_state = SUFFIX_L;
+                current_token += c;
+                l_count = 1;
+            }
+            else if (is_delimiter(c))
+            {
+                // finalize_token вызовется выше
+            }
+            else
+            {
+                num_state = INVALID;
+                current_token += c;
+            }
+            break;
+
+        // ---> Обработка буквы после числа <---
+        case NUMBER_END_POTENTIAL_SUFFIX:
+            // ---> Обработка буквы после числа <---
+            // 'potential_suffix_char' содержит букву, прочитанную на пред. шаге ('a')
+            // 'c' - это символ, идущий ПОСЛЕ этой буквы (например, разделитель)
+            {
+                char first_letter = potential_suffix_char; // 'a'
+                char first_letter_lower = tolower(first_letter);
+                potential_suffix_char = 0; // Сбрасываем
+
+                if (first_letter_lower == 'u')
+                {
+                    current_token += first_letter; // Добавляем 'u' к токену "12" -> "12u"
+                    num_state = SUFFIX_U; // Переходим в состояние суффикса
+                    char_to_reprocess = c; // Повторно обработаем 'c'
+                    goto process_char_again;
+                }
+                if (first_letter_lower == 'l')
+                {
+                    current_token += first_letter; // Добавляем 'l' к токену "12" -> "12l"
+                    num_state = SUFFIX_L;
+                    char_to_reprocess = c;
+                    goto process_char_again;
+                }
+                // Буква была не 'u' и не 'l'. Это ошибка для целочисленной константы.
+                current_token += first_letter; // Добавляем 'a' к токену "12" -> "12a"
+                num_state = INVALID; // Переходим в состояние ошибки
+                char_to_reprocess = c; // Повторно обработаем 'c' в состоянии INVALID
+                // (скорее всего, 'c' будет разделителем и вызовет finalize)
+                goto process_char_again;
+            }
+        // Конец case NUMBER_END_POTENTIAL_SUFFIX
+
+        // ---> Обработка состояний суффикса <---
+        case SUFFIX_U: // Прочитали ...u
+            if (c == 'l' || c == 'L')
+            {
+                if (l_count == 0)
+                {
+                    num_state = SUFFIX_UL;
+                    current_token += c;
+                    l_count = 1;
+                }
+                else
+                {
+                    num_state = INVALID;
+                    current_token += c;
+                }
+            }
+            else if (is_delimiter(c))
+            {
+                // finalize_token вызовется выше
+            }
+            else
+            {
+                num_state = INVALID;
+                current_token += c;
+            }
+            break;
+
+        case SUFFIX_L: // Прочитали ...l
+            if (c == 'l' || c == 'L')
+            {
+                if (l_count == 1)
+                {
+                    num_state = SUFFIX_LL;
+                    current_token += c;
+                    l_count = 2;
+                }
+                else
+                {
+                    num_state = INVALID;
+                    current_token += c;
+                }
+            }
+            else if (c == 'u' || c == 'U')
+            {
+                if (!has_u)
+                {
+                    num_state = SUFFIX_UL;
+                    current_token += c;
+                    has_u = true;
+                }
+                else
+                {
+                    num_state = INVALID;
+                    current_token += c;
+                }
+            }
+            else if (is_delimiter(c))
+            {
+                // finalize_token вызовется выше
+            }
+            else
+            {
+                num_state = INVALID;
+                current_token += c;
+            }
+            break;
+
+        case SUFFIX_LL: // Прочитали ...ll
+            if (c == 'u' || c == 'U')
+            {
+                if (!has_u)
+                {
+                    num_state = SUFFIX_ULL;
+                    current_token += c;
+                    has_u = true;
+                }
+                else
+                {
+                    num_state = INVALID;
+                    current_token += c;
+                }
+            }
+            else if (is_delimiter(c))
+            {
+                // finalize_token вызовется выше
+            }
+            else
+            {
+                num_state = INVALID;
+                current_token += c;
+            }
+            break;
+
+        case SUFFIX_UL: // Прочитали ...ul или ...lu
+            // После ul/lu разрешён только разделитель или один дополнительный l (чтобы получить строго ull/llu), но не ul*l* или lu*l*
+            if (c == 'l' || c == 'L')
+            {
+                // Если уже был l_count == 1 (ul/lu), то ещё один l даёт ull/llu (l_count == 2), но запрещаем больше l
+                if (l_count == 1 && !has_u)
+                {
+                    num_state = SUFFIX_ULL;
+                    current_token += c;
+                    l_count = 2;
+                }
+                else
+                {
+                    num_state = INVALID;
+                    current_token += c;
+                }
+            }
+            else if (is_delimiter(c))
+            {
+                // finalize_token вызовется выше
+            }
+            else
+            {
+                num_state = INVALID;
+                current_token += c;
+            }
+            break;
+
+        case SUFFIX_ULL: // Прочитали ...ull или ...llu
+            if (is_delimiter(c))
+            {
+                // finalize_token вызовется выше
+            }
+            else
+            {
+                num_state = INVALID;
+                current_token += c;
+            }
+            break;
+        } // Конец switch(num_state)
+
+        // 5. Серия цифр текущей системы счисления поглощается целиком,
+        // следующий символ (суффикс/разделитель) разбирается уже автоматом
+        if (num_state == DECIMAL || num_state == OCTAL || num_state == HEX)
+        {
+            const int base = num_state == DECIMAL ? 10 : num_state == OCTAL ? 8 : 16;
+            const char* run_end = simd::digit_run(p, end, base);
+            current_token.append(p, run_end);
+            p = run_end;
+        }
+    } // Конец while(p != end)
+
+    offset += chunk.size();
+    if (skip_disabled)
+    {
+        blank_tail = pp::blank_tail(chunk, blank_tail);
+    }
+}
@@ -0,0 +1,285 @@
+#pragma once
+
+// Индекс состояний автомата Lab2 (файл-спутник).
+// Через каждые interval байт входа сохраняется полное состояние автомата,
+// поэтому разбор любого участка можно начать с ближайшей контрольной точки,
+// а не с начала файла. Индекс привязан к размеру и времени изменения файла,
+// а каждый блок между точками - к своему хешу (FNV-1a), который проверяется
+// при чтении блока.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "scanner.hpp"
+
+struct Checkpoint
+{
+    ScannerState state; // состояние перед блоком
+    std::uint64_t block_hash; // хеш блока [offset, offset + interval)
+};
+
+struct StateIndex
+{
+    std::uint64_t file_size = 0;
+    std::uint64_t mtime_ns = 0;
+    std::uint64_t interval = 0;
+    std::vector<Checkpoint> checkpoints; // checkpoints[i] - на смещении i * interval
+};
+
+inline std::uint64_t fnv1a(const char* p, std::size_t n)
+{
+    std::uint64_t h = 14695981039346656037ull;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        h = (h ^ static_cast<unsigned char>(p[i])) * 1099511628211ull;
+    }
+    return h;
+}
+
+// Размер и время изменения файла
+inline bool file_identity(int fd, std::uint64_t& size, std::uint64_t& mtime_ns)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return false;
+    }
+    size = static_cast<std::uint64_t>(st.st_size);
+    mtime_ns = static_cast<std::uint64_t>(st.st_mtim.tv_sec) * 1000000000ull
+        + static_cast<std::uint64_t>(st.st_mtim.tv_nsec);
+    return true;
+}
+
+// Чтение блока целиком (до n байт, меньше - только в конце файла)
+inline std::size_t read_block(int fd, std::uint64_t offset, char* buf, std::size_t n)
+{
+    std::size_t got = 0;
+    while (got < n)
+    {
+        ssize_t k = pread(fd, buf + got, n - got, static_cast<off_t>(offset + got));
+        if (k <= 0)
+        {
+            break;
+        }
+        got += static_cast<std::size_t>(k);
+    }
+    return got;
+}
+
+namespace index_format
+{
+    constexpr char magic[8] = {'T', 'P', 'L', 'I', 'D', 'X', '1', '\0'};
+
+    inline void put(std::ostream& out, std::uint64_t v)
+    {
+        out.write(reinterpret_cast<const char*>(&v), sizeof v);
+    }
+
+    inline std::uint64_t get(std::istream& in)
+    {
+        std::uint64_t v = 0;
+        in.read(reinterpret_cast<char*>(&v), sizeof v);
+        return v;
+    }
+}
+
+inline bool write_index(const std::string& path, const StateIndex& index)
+{
+    using namespace index_format;
+    std::ofstream out(path, std::ios::binary);
+    out.write(magic, sizeof magic);
+    put(out, index.file_size);
+    put(out, index.mtime_ns);
+    put(out, index.interval);
+    put(out, index.checkpoints.size());
+    for (const Checkpoint& cp : index.checkpoints)
+    {
+        const ScannerState& s = cp.state;
+        put(out, cp.block_hash);
+        put(out, s.offset);
+        put(out, s.line);
+        put(out, s.token_offset);
+        put(out, s.token_line);
+        const char small[] = {static_cast<char>(s.state), static_cast<char>(s.num_state), s.potential_suffix_char,
+                              static_cast<char>(s.has_u), static_cast<char>(s.l_count), static_cast<char>(s.saw_digit)};
+        out.write(small, sizeof small);
+        put(out, s.current_token.size());
+        out.write(s.current_token.data(), static_cast<std::streamsize>(s.current_token.size()));
+    }
+    return static_cast<bool>(out.flush());
+}
+
+// Индекс из файла path; false, если файла нет или он не похож на индекс,
+// построенный build_index (тогда индекс нужно построить заново). Длины и
+// количества из файла проверяются до выделения памяти под них.
+inline bool read_index(const std::string& path, StateIndex& index)
+{
+    using namespace index_format;
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    std::streamoff length = in.tellg();
+    in.seekg(0);
+    char header[sizeof magic];
+    if (!in.read(header, sizeof header) || std::memcmp(header, magic, sizeof magic) != 0)
+    {
+        return false;
+    }
+    index.file_size = get(in);
+    index.mtime_ns = get(in);
+    index.interval = get(in);
+    std::uint64_t count = get(in);
+    // build_index ставит точку в начале каждого блока и еще одну в конце
+    // файла, если он кончается ровно на границе блока.
+    if (!in || index.interval == 0 || count != index.file_size / index.interval + 1)
+    {
+        return false;
+    }
+    index.checkpoints.clear();
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        Checkpoint cp;
+        ScannerState& s = cp.state;
+        cp.block_hash = get(in);
+        s.offset = get(in);
+        s.line = get(in);
+        s.token_offset = get(in);
+        s.token_line = get(in);
+        char small[6];
+        in.read(small, sizeof small);
+        s.state = static_cast<State>(small[0]);
+        s.num_state = static_cast<NumberState>(small[1]);
+        s.potential_suffix_char = small[2];
+        s.has_u = small[3] != 0;
+        s.l_count = small[4];
+        s.saw_digit = small[5] != 0;
+        // Токен набран из байт между своим началом и точкой и не длиннее
+        // остатка файла индекса.
+        std::uint64_t token_size = get(in);
+        std::streamoff rest = length - static_cast<std::streamoff>(in.tellg());
+        if (!in || s.offset != i * index.interval || s.token_offset > s.offset
+            || token_size > s.offset - s.token_offset || token_size > static_cast<std::uint64_t>(rest))
+        {
+            return false;
+        }
+        s.current_token.resize(token_size);
+        in.read(&s.current_token[0], static_cast<std::streamsize>(s.current_token.size()));
+        index.checkpoints.push_back(std::move(cp));
+    }
+    return static_cast<bool>(in);
+}
+
+// Полный проход по файлу с сохранением контрольных точек
+inline bool build_index(const char* path, std::uint64_t interval, StateIndex& index, std::string& error)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || !file_identity(fd, index.file_size, index.mtime_ns))
+    {
+        error = "not a readable regular file";
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return false;
+    }
+    index.interval = interval;
+    index.checkpoints.clear();
+
+    auto ignore = [](const Literal&) {};
+    Scanner<decltype(ignore)> scanner(ignore);
+    // Интервал задан пользователем; блок все равно не длиннее файла.
+    std::vector<char> buf(std::min(interval, index.file_size));
+    for (std::uint64_t offset = 0;; offset += interval)
+    {
+        std::size_t n = read_block(fd, offset, buf.data(), buf.size());
+        index.checkpoints.push_back({scanner.save(), fnv1a(buf.data(), n)});
+        if (n == 0)
+        {
+            break;
+        }
+        scanner.feed({buf.data(), n});
+        if (n < interval)
+        {
+            break;
+        }
+    }
+    close(fd);
+    return true;
+}
+
+// Разбор участка файла с контрольной точки first. Блоки читаются целиком,
+// их хеши сверяются с индексом; разбор заканчивается, когда done(scanner)
+// вернет true после очередного блока, или в конце файла. В scanned
+// (если задан) записывается число прочитанных байт.
+template <class Handler, class Done>
+bool scan_from_checkpoint(const char* path, const StateIndex& index, std::size_t first,
+                          Handler handler, Done done, std::string& error, std::uint64_t* scanned = nullptr)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    std::uint64_t size = 0;
+    std::uint64_t mtime_ns = 0;
+    if (fd < 0 || !file_identity(fd, size, mtime_ns))
+    {
+        error = "not a readable regular file";
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return false;
+    }
+    if (size != index.file_size || mtime_ns != index.mtime_ns)
+    {
+        error = "index is out of date (size or mtime changed)";
+        close(fd);
+        return false;
+    }
+
+    Scanner<Handler> scanner(std::move(handler));
+    // Блок не длиннее файла, размер которого уже сверен с индексом.
+    std::vector<char> buf(std::min(index.interval, index.file_size));
+    bool ok = true;
+    for (std::size_t i = first; i < index.checkpoints.size(); ++i)
+    {
+        if (i == first)
+        {
+            scanner.restore(index.checkpoints[i].state);
+        }
+        std::uint64_t offset = i * index.interval;
+        std::size_t n = read_block(fd, offset, buf.data(), buf.size());
+        if (fnv1a(buf.data(), n) != index.checkpoints[i].block_hash)
+        {
+            error = "index is out of date (block hash mismatch)";
+            ok = false;
+            break;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        scanner.feed({buf.data(), n});
+        if (scanned)
+        {
+            *scanned += n;
+        }
+        if (n < index.interval)
+        {
+            break;
+        }
+        if (done(scanner))
+        {
+            break;
+        }
+    }
+    if (ok)
+    {
+        scanner.finish();
+    }
+    close(fd);
+    return ok;
+}
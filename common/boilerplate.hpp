@@ -0,0 +1,72 @@
+#pragma once
+
+// Известные блоки в начале файлов (Lab1/2.cpp --boilerplate), например
+// одинаковый заголовок с лицензией. Для каждого блока заранее готовится
+// его образ после очистки; если файл начинается с блока, автомат его не
+// разбирает - в выход сразу идет образ, а автомат начинает с байта после
+// блока. Начало файла ищется по хешу префикса нужной длины (по одной
+// проверке на каждую различную длину блоков) и сверяется memcmp.
+//
+// Блок годится для пропуска, только если после него автомат находится в
+// начальном состоянии: это проверяет вызывающий код при добавлении
+// (Lab1/2.cpp: блок из комментариев и пробелов, кончающийся переводом
+// строки).
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace boilerplate {
+
+struct Block {
+  std::string text;  // как в исходном файле
+  std::string image; // после очистки
+};
+
+class Set {
+public:
+  void add(std::string text, std::string image) {
+    std::size_t h = std::hash<std::string_view>()(text);
+    if (std::find(lengths_.begin(), lengths_.end(), text.size()) ==
+        lengths_.end()) {
+      lengths_.push_back(text.size());
+      // Сначала длинные: из двух подходящих блоков выбирается больший.
+      std::sort(lengths_.rbegin(), lengths_.rend());
+    }
+    by_hash_.emplace(h, blocks_.size());
+    blocks_.push_back({std::move(text), std::move(image)});
+  }
+
+  bool empty() const { return blocks_.empty(); }
+
+  // Блок, которым начинается data, или nullptr.
+  const Block *match(std::string_view data) const {
+    for (std::size_t length : lengths_) {
+      if (length > data.size()) {
+        continue;
+      }
+      std::string_view prefix = data.substr(0, length);
+      auto range = by_hash_.equal_range(std::hash<std::string_view>()(prefix));
+      for (auto it = range.first; it != range.second; ++it) {
+        const Block &block = blocks_[it->second];
+        if (block.text.size() == length &&
+            std::memcmp(block.text.data(), prefix.data(), length) == 0) {
+          return &block;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+private:
+  std::vector<Block> blocks_;
+  std::vector<std::size_t> lengths_;
+  std::unordered_multimap<std::size_t, std::size_t> by_hash_;
+};
+
+} // namespace boilerplate
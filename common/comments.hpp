@@ -0,0 +1,208 @@
+#pragma once
+
+// Поток комментариев, которые вырезает автомат strip.hpp (Lab1/2.cpp
+// --comments FILE). Автомат сообщает о комментариях по ходу разбора того
+// же блока входа, поэтому чистый код и указатель комментариев получаются
+// за один проход. Для каждого комментария пишется запись: смещение его
+// начала (байт '/') во входе, номер строки, вид (/* */ или //) и текст
+// между ограничителями. Номера строк считаются только при включенной
+// выдаче: переводы строк подсчитываются участками между комментариями.
+//
+// Форматы:
+//   JSONL - по объекту на строку:
+//     {"file":"a.c","offset":120,"line":7,"kind":"block","text":"..."}
+//     Строки JSON должны быть в UTF-8, а исходник может быть в другой
+//     кодировке (например, CP1251). Байт, не входящий в правильную
+//     последовательность UTF-8, пишется как символ Latin-1 с тем же
+//     кодом (\u00XX); точные байты текста дает формат BINARY.
+//   BINARY - заголовок "TPLCMT1\n", затем записи
+//     u8 вид (0 - block, 1 - line, 2 - начало файла), u64 смещение,
+//     u64 строка, u32 длина, байты текста (у записи файла - путь);
+//     числа в порядке little-endian.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "io.hpp"
+
+namespace comments {
+
+enum class Kind { BLOCK, LINE };
+enum class Format { JSONL, BINARY };
+
+// Приемник по умолчанию: автомат без выдачи комментариев.
+struct None {
+  static constexpr bool enabled = false;
+  void begin_chunk(std::string_view) {}
+  void end_chunk() {}
+  void open(const char *, Kind) {}
+  void text(const char *, std::size_t) {}
+  void close() {}
+};
+
+// Запись комментариев в out. Интерфейс для strip::Stripper:
+// begin_chunk/end_chunk охватывают каждый блок входа; open получает
+// указатель на первый байт после открывающего ограничителя, text - байты
+// комментария (у /* */ вместе с закрывающей '*'), close завершает
+// комментарий.
+class Writer {
+public:
+  static constexpr bool enabled = true;
+
+  Writer(io::Output &out, Format format) : out_(out), format_(format) {
+    if (format_ == Format::BINARY) {
+      out_.write("TPLCMT1\n", 8);
+    }
+  }
+
+  // Начало очередного файла: смещения и строки считаются заново.
+  void start_file(std::string_view path) {
+    file_ = path;
+    offset_ = 0;
+    line_ = 1;
+    if (format_ == Format::BINARY) {
+      header(2, 0, 0, path.size());
+      out_.write(path.data(), path.size());
+    }
+  }
+
+  void begin_chunk(std::string_view in) {
+    chunk_ = in.data();
+    counted_ = in.data();
+    chunk_end_ = in.data() + in.size();
+  }
+
+  void end_chunk() {
+    count_lines(chunk_end_);
+    offset_ += static_cast<std::uint64_t>(chunk_end_ - chunk_);
+  }
+
+  void open(const char *p, Kind kind) {
+    count_lines(p);
+    // Открывающий '/' мог остаться в прошлом блоке - смещение от этого
+    // не зависит.
+    start_ = offset_ + static_cast<std::uint64_t>(p - chunk_) - 2;
+    start_line_ = line_;
+    kind_ = kind;
+    text_.clear();
+  }
+
+  void text(const char *p, std::size_t n) { text_.append(p, n); }
+
+  void close() {
+    if (kind_ == Kind::BLOCK && !text_.empty() && text_.back() == '*') {
+      text_.pop_back();
+    }
+    if (format_ == Format::BINARY) {
+      header(kind_ == Kind::BLOCK ? 0 : 1, start_, start_line_, text_.size());
+      out_.write(text_.data(), text_.size());
+      return;
+    }
+    char numbers[96];
+    int n = std::snprintf(numbers, sizeof numbers,
+                          "\",\"offset\":%llu,\"line\":%llu,\"kind\":\"%s\"",
+                          static_cast<unsigned long long>(start_),
+                          static_cast<unsigned long long>(start_line_),
+                          kind_ == Kind::BLOCK ? "block" : "line");
+    out_.write("{\"file\":\"", 9);
+    write_escaped(file_);
+    out_.write(numbers, static_cast<std::size_t>(n));
+    out_.write(",\"text\":\"", 9);
+    write_escaped(text_);
+    out_.write("\"}\n", 3);
+  }
+
+private:
+  void count_lines(const char *p) {
+    line_ += static_cast<std::uint64_t>(std::count(counted_, p, '\n'));
+    counted_ = p;
+  }
+
+  void header(unsigned kind, std::uint64_t offset, std::uint64_t line,
+              std::size_t length) {
+    char bytes[21];
+    bytes[0] = static_cast<char>(kind);
+    for (int i = 0; i < 8; ++i) {
+      bytes[1 + i] = static_cast<char>(offset >> (8 * i));
+      bytes[9 + i] = static_cast<char>(line >> (8 * i));
+    }
+    for (int i = 0; i < 4; ++i) {
+      bytes[17 + i] = static_cast<char>(length >> (8 * i));
+    }
+    out_.write(bytes, sizeof bytes);
+  }
+
+  // Длина правильной последовательности UTF-8 с байта p (без лишне
+  // длинных записей, суррогатов и кодов больше U+10FFFF); 0, если ее нет.
+  static std::size_t utf8_length(const unsigned char *p,
+                                 const unsigned char *end) {
+    std::size_t length = p[0] >= 0xF0 ? 4 : p[0] >= 0xE0 ? 3 : 2;
+    if (p[0] < 0xC2 || p[0] > 0xF4 ||
+        static_cast<std::size_t>(end - p) < length) {
+      return 0;
+    }
+    for (std::size_t i = 1; i < length; ++i) {
+      if ((p[i] & 0xC0) != 0x80) {
+        return 0;
+      }
+    }
+    // Допустимые вторые байты после E0, ED, F0 и F4
+    if ((p[0] == 0xE0 && p[1] < 0xA0) || (p[0] == 0xED && p[1] > 0x9F) ||
+        (p[0] == 0xF0 && p[1] < 0x90) || (p[0] == 0xF4 && p[1] > 0x8F)) {
+      return 0;
+    }
+    return length;
+  }
+
+  void write_escaped(std::string_view s) {
+    auto p = reinterpret_cast<const unsigned char *>(s.data());
+    auto end = p + s.size();
+    while (p != end) {
+      unsigned char c = *p;
+      if (c == '"' || c == '\\') {
+        out_.put('\\');
+        out_.put(static_cast<char>(c));
+      } else if (c >= 0x80) {
+        std::size_t length = utf8_length(p, end);
+        if (length) {
+          out_.write(reinterpret_cast<const char *>(p), length);
+          p += length;
+          continue;
+        }
+        escape(c);
+      } else if (c < 0x20) {
+        escape(c);
+      } else {
+        out_.put(static_cast<char>(c));
+      }
+      ++p;
+    }
+  }
+
+  void escape(unsigned char c) {
+    char esc[8];
+    std::snprintf(esc, sizeof esc, "\\u%04x", c);
+    out_.write(esc, 6);
+  }
+
+  io::Output &out_;
+  Format format_;
+  std::string file_;
+  // Блок входа и его смещение от начала файла
+  const char *chunk_ = nullptr;
+  const char *chunk_end_ = nullptr;
+  const char *counted_ = nullptr; // переводы строк до него учтены
+  std::uint64_t offset_ = 0;
+  std::uint64_t line_ = 1;
+  // Текущий комментарий
+  std::uint64_t start_ = 0;
+  std::uint64_t start_line_ = 0;
+  Kind kind_ = Kind::BLOCK;
+  std::string text_;
+};
+
+} // namespace comments
@@ -0,0 +1,682 @@
+#pragma once
+
+// Описания языков для удаления комментариев (Lab1/2.cpp --dialect).
+// Описание задает открывающие последовательности комментариев, кавычки,
+// правила экранирования, тройные кавычки, сырые строки (C++, Rust, Swift,
+// C# @"..."), вложенность блочных комментариев, апострофы Rust и Scala и
+// регулярные выражения JavaScript. Из него строится таблица классов байтов
+// на 256 элементов, по которой автомат пропускает обычный текст участками,
+// как и цикл для C в strip.hpp: байт проверяется одним обращением к
+// таблице, комментарии пропускаются через memchr.
+//
+// Для C по-прежнему используется strip::Stripper с политикой, собранной
+// на этапе компиляции; описание "c" нужно для выбора по расширению.
+
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dialect {
+
+struct Quote {
+  char quote;
+  bool escapes; // '\\' экранирует следующий символ
+  bool triple;  // тройная кавычка открывает многострочную строку
+  bool triple_raw = false; // в тройных кавычках '\\' не экранирует
+};
+
+// Сырые строки, в которых '\\' не экранирует.
+enum class Raw {
+  NONE,
+  CPP,   // R"delim(...)delim"; там же апостроф - разделитель разрядов
+  RUST,  // r"...", r#"..."# (и br, cr)
+  SWIFT, // #"..."#, #"""..."""#
+  CSHARP, // @"..." ("" внутри - кавычка), $@"..." и @$"..."
+};
+
+struct Dialect {
+  std::string_view name;
+  std::string_view extensions;       // через пробел, с точкой
+  std::string_view line_comments[2]; // до двух, пустые не используются
+  std::string_view block_open;       // пусто - блочных комментариев нет
+  std::string_view block_close;
+  Quote quotes[3];
+  int quote_count;
+  Raw raw;
+  bool word_comments; // комментарий только в начале слова (shell)
+  bool shebang;       // первая строка "#!" - не комментарий
+  bool nested;        // блочные комментарии вкладываются друг в друга
+  // Апостроф открывает литерал, только если за ним один символ или
+  // экранирование и закрывающий апостроф; иначе это время жизни Rust
+  // ('a) или символ Scala ('name).
+  bool lifetimes;
+  // '/' после знака операции, '(', ',' или '=' (и в начале файла)
+  // открывает регулярное выражение /.../ (JavaScript).
+  bool regex;
+};
+
+// Длина открывающих и закрывающих последовательностей - не больше 2.
+inline constexpr Dialect dialects[] = {
+    {"c", ".c .h", {"//", ""}, "/*", "*/",
+     {{'"', true, false}, {'\'', true, false}}, 2, Raw::NONE, false, false,
+     false, false, false},
+    {"cpp", ".cpp .cc .cxx .c++ .hpp .hh .hxx .h++ .ipp", {"//", ""}, "/*",
+     "*/", {{'"', true, false}, {'\'', true, false}}, 2, Raw::CPP, false,
+     false, false, false, false},
+    {"java", ".java", {"//", ""}, "/*", "*/",
+     {{'"', true, true}, {'\'', true, false}}, 2, Raw::NONE, false, false,
+     false, false, false},
+    {"kotlin", ".kt .kts", {"//", ""}, "/*", "*/",
+     {{'"', true, true, true}, {'\'', true, false}}, 2, Raw::NONE, false,
+     false, true, false, false},
+    {"csharp", ".cs", {"//", ""}, "/*", "*/",
+     {{'"', true, true, true}, {'\'', true, false}}, 2, Raw::CSHARP, false,
+     false, false, false, false},
+    {"go", ".go", {"//", ""}, "/*", "*/",
+     {{'"', true, false}, {'\'', true, false}, {'`', false, false}}, 3,
+     Raw::NONE, false, false, false, false, false},
+    {"rust", ".rs", {"//", ""}, "/*", "*/",
+     {{'"', true, false}, {'\'', true, false}}, 2, Raw::RUST, false, false,
+     true, true, false},
+    {"swift", ".swift", {"//", ""}, "/*", "*/", {{'"', true, true}}, 1,
+     Raw::SWIFT, false, false, true, false, false},
+    {"scala", ".scala .sc", {"//", ""}, "/*", "*/",
+     {{'"', true, true, true}, {'\'', true, false}}, 2, Raw::NONE, false,
+     false, true, true, false},
+    {"js", ".js .mjs .cjs .jsx .ts .tsx", {"//", ""}, "/*", "*/",
+     {{'"', true, false}, {'\'', true, false}, {'`', true, false}}, 3,
+     Raw::NONE, false, false, false, false, true},
+    {"shell", ".sh .bash .zsh .ksh", {"#", ""}, "", "",
+     {{'"', true, false}, {'\'', false, false}}, 2, Raw::NONE, true, true,
+     false, false, false},
+    {"python", ".py .pyw", {"#", ""}, "", "",
+     {{'"', true, true}, {'\'', true, true}}, 2, Raw::NONE, false, true,
+     false, false, false},
+    {"sql", ".sql", {"--", ""}, "/*", "*/",
+     {{'\'', false, false}, {'"', false, false}}, 2, Raw::NONE, false, false,
+     false, false, false},
+};
+
+inline const Dialect *find(std::string_view name) {
+  for (const Dialect &d : dialects) {
+    if (d.name == name) {
+      return &d;
+    }
+  }
+  return nullptr;
+}
+
+// Описание по расширению файла (.gz и .zst не учитываются); nullptr,
+// если расширение неизвестно.
+inline const Dialect *for_path(std::string_view path) {
+  for (std::string_view suffix : {".gz", ".zst"}) {
+    if (path.size() > suffix.size() &&
+        path.substr(path.size() - suffix.size()) == suffix) {
+      path.remove_suffix(suffix.size());
+    }
+  }
+  std::size_t dot = path.rfind('.');
+  if (dot == std::string_view::npos || path.find('/', dot) != path.npos) {
+    return nullptr;
+  }
+  std::string_view ext = path.substr(dot);
+  for (const Dialect &d : dialects) {
+    std::string_view list = d.extensions;
+    while (!list.empty()) {
+      std::size_t space = list.find(' ');
+      if (list.substr(0, space) == ext) {
+        return &d;
+      }
+      list.remove_prefix(space == list.npos ? list.size() : space + 1);
+    }
+  }
+  return nullptr;
+}
+
+// Автомат по описанию. Кормится частями, как strip::Stripper; если для
+// решения не хватает нескольких символов в конце части (начало "//",
+// тройная кавычка, разделитель сырой строки), они откладываются до
+// следующей части.
+class Stripper {
+public:
+  explicit Stripper(const Dialect &d) : d_(d) {
+    for (std::string_view open : d.line_comments) {
+      if (!open.empty()) {
+        classes_[byte(open[0])] |= OPENER;
+      }
+    }
+    if (!d.block_open.empty()) {
+      classes_[byte(d.block_open[0])] |= OPENER;
+    }
+    for (int i = 0; i < d.quote_count; ++i) {
+      classes_[byte(d.quotes[i].quote)] |= QUOTE;
+      quotes_[byte(d.quotes[i].quote)] = d.quotes[i];
+    }
+    if (d.word_comments) {
+      word_start_ = " \t\n\r;|&()";
+    }
+    if (d.raw == Raw::RUST || d.raw == Raw::SWIFT) {
+      classes_[byte('#')] |= HASH;
+    }
+  }
+
+  template <class Sink> void feed(std::string_view in, Sink &out) {
+    std::string_view data = in;
+    if (!held_.empty()) {
+      held_.append(in);
+      joined_.swap(held_);
+      held_.clear();
+      data = joined_;
+    }
+    std::size_t stop = run(data, out, false);
+    remember(data, stop);
+    held_.assign(data.substr(stop));
+  }
+
+  template <class Sink> void finish(Sink &out) {
+    std::string rest;
+    rest.swap(held_);
+    run(rest, out, true);
+    state_ = NORMAL;
+    depth_ = 0;
+    run_ = NO_RUN;
+    code_ = '\n';
+  }
+
+private:
+  enum Run { NO_RUN, NUMBER, WORD };
+  enum State {
+    NORMAL,
+    SHEBANG,
+    LINE_COMMENT,
+    BLOCK_COMMENT,
+    STRING,
+    RAW,
+    REGEX
+  };
+  enum Class : unsigned char { PLAIN = 0, OPENER = 1, QUOTE = 2, HASH = 4 };
+
+  // Символов, которые нужно видеть после кавычки: тройная кавычка или
+  // символьный литерал из символа UTF-8 с апострофами.
+  std::size_t quote_lookahead() const { return d_.lifetimes ? 6 : 3; }
+
+  static unsigned char byte(char c) { return static_cast<unsigned char>(c); }
+
+  static bool is_ident(char c) {
+    return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9');
+  }
+
+  // Символ за back позиций до at (до начала входа - перевод строки).
+  char before(std::string_view data, const char *at, std::size_t back) const {
+    std::size_t pos = static_cast<std::size_t>(at - data.data());
+    if (pos >= back) {
+      return at[-static_cast<std::ptrdiff_t>(back)];
+    }
+    return history_[back - pos - 1];
+  }
+
+  // Последние символы перед точкой остановки - для before().
+  void remember(std::string_view data, std::size_t stop) {
+    if (stop >= 2) {
+      history_ = {{data[stop - 1], data[stop - 2]}};
+    } else if (stop == 1) {
+      history_ = {{data[0], history_[0]}};
+    }
+    if (d_.raw == Raw::CPP) {
+      run_ = run_before(data, data.data() + stop);
+    }
+  }
+
+  // Последний непробельный символ кода в [p, q) - для regex_may_follow.
+  void remember_code(const char *p, const char *q) {
+    while (q != p && (q[-1] == ' ' || q[-1] == '\t' || q[-1] == '\n' ||
+                      q[-1] == '\r')) {
+      --q;
+    }
+    if (q != p) {
+      code_ = q[-1];
+    }
+  }
+
+  // После такого символа кода '/' начинает выражение, а не делит.
+  static bool regex_may_follow(char c) {
+    return c == '\n' ||
+           (c != '\0' && std::strchr("(,=:[!&|?{};+-*%<>~^/", c));
+  }
+
+  // Символы лексемы числа: цифры, буквы (0x, суффиксы, экспонента), точка
+  // и разделители разрядов.
+  static bool in_number(char c) { return is_ident(c) || c == '.' || c == '\''; }
+
+  // Вид лексемы, которая кончается перед at (не дальше 64 символов назад;
+  // в начале data продолжается лексема из прошлой части).
+  Run run_before(std::string_view data, const char *at) const {
+    const char *p = at;
+    while (p != data.data() && in_number(p[-1])) {
+      if (at - --p > 64) {
+        return WORD;
+      }
+    }
+    if (p == at) {
+      return p == data.data() ? run_ : NO_RUN;
+    }
+    if (p == data.data() && run_ != NO_RUN) {
+      return run_;
+    }
+    return *p >= '0' && *p <= '9' ? NUMBER : WORD;
+  }
+
+  // Апостроф в q - разделитель разрядов C++14 (0x1'0000), если он внутри
+  // числа и за ним цифра.
+  bool digit_separator(std::string_view data, const char *q,
+                       const char *end) const {
+    return end - q >= 2 && std::isxdigit(byte(q[1])) &&
+           run_before(data, q) == NUMBER;
+  }
+
+  static bool starts(const char *at, const char *end, std::string_view s) {
+    return static_cast<std::size_t>(end - at) >= s.size() &&
+           std::memcmp(at, s.data(), s.size()) == 0;
+  }
+
+  static bool tripled(const char *at, const char *end) {
+    return end - at >= 3 && at[1] == at[0] && at[2] == at[0];
+  }
+
+  // Разбор data; возвращает позицию, с которой нужно продолжить, когда
+  // придут следующие символы (при last - всегда конец data).
+  template <class Sink>
+  std::size_t run(std::string_view data, Sink &out, bool last) {
+    const char *p = data.data();
+    const char *end = p + data.size();
+    // Не хватает n символов от at, а вход еще не кончился
+    auto short_of = [&](const char *at, std::size_t n) {
+      return !last && static_cast<std::size_t>(end - at) < n;
+    };
+    auto stop = [&](const char *at) {
+      return static_cast<std::size_t>(at - data.data());
+    };
+
+    if (first_ && p != end) {
+      if (short_of(p, 2)) {
+        return 0;
+      }
+      first_ = false;
+      if (d_.shebang && starts(p, end, "#!")) {
+        state_ = SHEBANG;
+      }
+    }
+
+    while (p != end) {
+      switch (state_) {
+      case NORMAL: {
+        const char *q = p;
+        while (q != end && !classes_[byte(*q)]) {
+          ++q;
+        }
+        if (q != p) {
+          out.write(p, q - p);
+          if (d_.regex) {
+            remember_code(p, q);
+          }
+        }
+        if (q == end) {
+          return data.size();
+        }
+        p = q;
+        if (classes_[byte(*q)] & QUOTE) {
+          code_ = '"'; // после строки - операнд
+          if (short_of(q, quote_lookahead())) {
+            return stop(q);
+          }
+          p = open_string(data, q, end, last, out);
+          if (!p) {
+            return stop(q);
+          }
+          break;
+        }
+        if (classes_[byte(*q)] & HASH) {
+          p = open_hashed(data, q, end, last, out);
+          if (!p) {
+            return stop(q);
+          }
+          break;
+        }
+        // Начало комментария?
+        if (short_of(q, 2)) {
+          return stop(q);
+        }
+        bool word = word_start_.empty() ||
+                    word_start_.find(before(data, q, 1)) != word_start_.npos;
+        std::size_t length = 0;
+        for (std::string_view open : d_.line_comments) {
+          if (!open.empty() && word && starts(q, end, open)) {
+            state_ = LINE_COMMENT;
+            length = open.size();
+          }
+        }
+        if (!length && !d_.block_open.empty() &&
+            starts(q, end, d_.block_open)) {
+          state_ = BLOCK_COMMENT;
+          length = d_.block_open.size();
+        }
+        if (!length && d_.regex && *q == '/' && regex_may_follow(code_)) {
+          state_ = REGEX;
+          regex_class_ = false;
+        } else if (!length) {
+          code_ = *q;
+        }
+        if (!length) {
+          out.write(q, 1);
+          length = 1;
+        }
+        p = q + length;
+        break;
+      }
+
+      case SHEBANG:
+      case LINE_COMMENT: {
+        const char *q = p;
+        while (q != end && *q != '\n' && *q != '\r') {
+          ++q;
+        }
+        if (state_ == SHEBANG) {
+          out.write(p, q - p);
+        }
+        if (q != end) {
+          state_ = NORMAL;
+        }
+        p = q;
+        break;
+      }
+
+      case BLOCK_COMMENT: {
+        const char close = d_.block_close[0];
+        const char *q = p;
+        if (d_.nested) {
+          const char open = d_.block_open[0];
+          while (q != end && *q != close && *q != open) {
+            ++q;
+          }
+        } else {
+          q = static_cast<const char *>(std::memchr(p, close, end - p));
+        }
+        if (!q || q == end) {
+          return data.size();
+        }
+        if (short_of(q, 2)) {
+          return stop(q);
+        }
+        if (starts(q, end, d_.block_close)) {
+          p = q + d_.block_close.size();
+          if (depth_ > 0) {
+            --depth_;
+          } else {
+            out.put(' ');
+            state_ = NORMAL;
+          }
+        } else if (d_.nested && starts(q, end, d_.block_open)) {
+          ++depth_;
+          p = q + d_.block_open.size();
+        } else {
+          p = q + 1;
+        }
+        break;
+      }
+
+      case STRING: {
+        const char *q = p;
+        while (q != end && *q != quote_.quote && !(escapes_ && *q == '\\')) {
+          ++q;
+        }
+        if (q != p) {
+          out.write(p, q - p);
+        }
+        p = q;
+        if (q == end) {
+          break;
+        }
+        std::size_t length = 1;
+        if (*q != quote_.quote) {
+          if (short_of(q, 2)) {
+            return stop(q);
+          }
+          length = end - q >= 2 ? 2 : 1;
+        } else if (doubled_) {
+          if (short_of(q, 2)) {
+            return stop(q);
+          }
+          if (end - q >= 2 && q[1] == quote_.quote) {
+            length = 2;
+          } else {
+            state_ = NORMAL;
+          }
+        } else if (triple_) {
+          if (short_of(q, 3)) {
+            return stop(q);
+          }
+          if (tripled(q, end)) {
+            length = 3;
+            state_ = NORMAL;
+          }
+        } else {
+          state_ = NORMAL;
+        }
+        out.write(q, length);
+        p = q + length;
+        break;
+      }
+
+      case REGEX: {
+        const char *q = p;
+        while (q != end && *q != '/' && *q != '\\' && *q != '[' &&
+               *q != ']' && *q != '\n') {
+          ++q;
+        }
+        out.write(p, q - p);
+        p = q;
+        if (q == end) {
+          break;
+        }
+        std::size_t length = 1;
+        if (*q == '\\') {
+          if (short_of(q, 2)) {
+            return stop(q);
+          }
+          length = end - q >= 2 && q[1] != '\n' ? 2 : 1;
+        } else if (*q == '[' || *q == ']') {
+          regex_class_ = *q == '[';
+        } else if (*q == '\n' || !regex_class_) {
+          // Перевод строки - выражение не закрыто, дальше обычный код.
+          state_ = NORMAL;
+          code_ = '"';
+        }
+        out.write(q, length);
+        p = q + length;
+        break;
+      }
+
+      case RAW: {
+        auto q = static_cast<const char *>(
+            std::memchr(p, raw_close_[0], end - p));
+        if (!q) {
+          out.write(p, end - p);
+          return data.size();
+        }
+        out.write(p, q - p);
+        if (short_of(q, raw_close_.size())) {
+          return stop(q);
+        }
+        std::size_t length = 1;
+        if (starts(q, end, raw_close_)) {
+          length = raw_close_.size();
+          state_ = NORMAL;
+        }
+        out.write(q, length);
+        p = q + length;
+        break;
+      }
+      }
+    }
+    return data.size();
+  }
+
+  // Открывающая кавычка в q (за ней доступно не меньше quote_lookahead()
+  // символов, если вход не кончился). Возвращает позицию после открытия
+  // или nullptr, если для сырой строки не хватает символов.
+  template <class Sink>
+  const char *open_string(std::string_view data, const char *q,
+                          const char *end, bool last, Sink &out) {
+    const Quote &quote = quotes_[byte(*q)];
+    if ((d_.lifetimes && *q == '\'' && !char_literal(q, end)) ||
+        (d_.raw == Raw::CPP && *q == '\'' && digit_separator(data, q, end))) {
+      out.write(q, 1);
+      return q + 1;
+    }
+    if (d_.raw == Raw::RUST && *q == '"' && rust_raw(data, q)) {
+      raw_close_ = "\"";
+      out.write(q, 1);
+      state_ = RAW;
+      return q + 1;
+    }
+    doubled_ = false;
+    if (d_.raw == Raw::CSHARP && *q == '"' &&
+        (before(data, q, 1) == '@' ||
+         (before(data, q, 1) == '$' && before(data, q, 2) == '@'))) {
+      // Строка дословно: '\\' не экранирует, "" - кавычка
+      quote_ = quote;
+      triple_ = false;
+      escapes_ = false;
+      doubled_ = true;
+      out.write(q, 1);
+      state_ = STRING;
+      return q + 1;
+    }
+    if (d_.raw == Raw::CPP && *q == '"' && before(data, q, 1) == 'R') {
+      // Префикс R, uR, UR, LR или u8R, но не конец идентификатора
+      char prefix = before(data, q, 2);
+      if (!is_ident(prefix) || std::strchr("uUL8", prefix)) {
+        // Разделитель - до 16 символов перед '('
+        const char *open = q + 1;
+        while (open != end && open - q <= 17 && *open != '(' &&
+               *open != '"' && *open != ' ' && *open != ')' &&
+               *open != '\\' && *open != '\n') {
+          ++open;
+        }
+        if (open == end && !last) {
+          return nullptr;
+        }
+        if (open != end && *open == '(') {
+          raw_close_ = ")" + std::string(q + 1, open) + "\"";
+          out.write(q, open + 1 - q);
+          state_ = RAW;
+          return open + 1;
+        }
+      }
+    }
+    quote_ = quote;
+    triple_ = quote.triple && tripled(q, end);
+    escapes_ = quote.escapes && !(triple_ && quote.triple_raw);
+    std::size_t length = triple_ ? 3 : 1;
+    out.write(q, length);
+    state_ = STRING;
+    return q + length;
+  }
+
+  // Апостроф в q открывает символьный литерал: за ним экранирование или
+  // один символ UTF-8 и закрывающий апостроф.
+  static bool char_literal(const char *q, const char *end) {
+    if (end - q >= 2 && q[1] == '\\') {
+      return true;
+    }
+    unsigned char lead = end - q >= 2 ? byte(q[1]) : 0;
+    std::ptrdiff_t length = lead >= 0xF0   ? 4
+                            : lead >= 0xE0 ? 3
+                            : lead >= 0xC0 ? 2
+                                           : 1;
+    return end - q >= length + 2 && q[1] != '\'' && q[length + 1] == '\'';
+  }
+
+  // Перед кавычкой в q префикс r (br, cr) сырой строки Rust, но не конец
+  // идентификатора.
+  bool rust_raw(std::string_view data, const char *q) const {
+    const char *r = q;
+    while (r != data.data() && r[-1] == '#') {
+      --r;
+    }
+    if (before(data, r, 1) != 'r') {
+      return false;
+    }
+    char prefix = before(data, r, 2);
+    return !is_ident(prefix) || prefix == 'b' || prefix == 'c';
+  }
+
+  // Решетки в q: у Rust после r и у Swift перед кавычкой они открывают
+  // сырую строку, которая кончается кавычкой с тем же числом решеток.
+  // Возвращает позицию после разобранного или nullptr, если решетки
+  // доходят до конца части.
+  template <class Sink>
+  const char *open_hashed(std::string_view data, const char *q,
+                          const char *end, bool last, Sink &out) {
+    const char *quote = q;
+    while (quote != end && *quote == '#') {
+      ++quote;
+    }
+    if (!last && end - quote < 3) {
+      return nullptr;
+    }
+    std::string hashes(q, quote);
+    bool opens = quote != end && *quote == '"' &&
+                 (d_.raw == Raw::SWIFT || rust_raw(data, quote));
+    if (!opens) {
+      out.write(q, quote - q);
+      return quote;
+    }
+    std::size_t length = 1;
+    if (d_.raw == Raw::SWIFT && tripled(quote, end)) {
+      length = 3;
+    }
+    raw_close_ = std::string(length, '"') + hashes;
+    out.write(q, quote + length - q);
+    state_ = RAW;
+    return quote + length;
+  }
+
+  const Dialect &d_;
+  std::array<unsigned char, 256> classes_{};
+  std::array<Quote, 256> quotes_{};
+  std::string_view word_start_; // после каких символов начинается слово
+
+  State state_ = NORMAL;
+  Quote quote_{};
+  bool triple_ = false;
+  bool escapes_ = false;
+  bool doubled_ = false; // удвоенная кавычка не закрывает строку
+  int depth_ = 0; // вложенных блочных комментариев сверх первого
+  std::string raw_close_; // ")delim\"", "\"##" и т.п.
+  bool first_ = true;
+  std::array<char, 2> history_{{'\n', '\n'}};
+  Run run_ = NO_RUN; // лексема, которая кончается перед точкой остановки
+  char code_ = '\n'; // последний символ кода ('\n' - начало файла)
+  bool regex_class_ = false; // внутри [...] выражения
+  std::string held_;
+  std::string joined_;
+};
+
+// Обработка источника блоками, как strip::strip_stream.
+template <class Source, class Sink>
+void strip_stream(const Dialect &d, Source &in, Sink &out) {
+  Stripper stripper(d);
+  std::vector<char> buf(1 << 16);
+  while (std::size_t n = in.read(buf.data(), buf.size())) {
+    stripper.feed({buf.data(), n}, out);
+  }
+  stripper.finish(out);
+}
+
+} // namespace dialect
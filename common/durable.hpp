@@ -0,0 +1,218 @@
+#pragma once
+
+// Атомарная и устойчивая к сбоям замена группы файлов (перезапись на
+// месте в Lab0). Новое содержимое каждого файла пишется во временный файл
+// рядом с ним (create_temp: уникальное имя и права исходного файла еще до
+// записи данных); commit() сначала делает устойчивыми все временные файлы
+// разом, затем переименовывает их поверх исходных и в конце
+// синхронизирует каталоги, чтобы устойчивыми стали и переименования.
+// Переименование идет только после записи данных на диск, поэтому после
+// сбоя на любом шаге каждый файл либо старый, либо новый целиком. Цена -
+// одна синхронизация на группу, а не fsync на каждый файл.
+//
+// Синхронизация группы: если на файловой системе много файлов группы -
+// один syncfs на всю систему; иначе запись всех файлов сначала
+// запускается (sync_file_range без ожидания), а затем каждый дожидается
+// fsync, так что запись идет параллельно и фиксации журнала объединяются.
+// fsync, а не fdatasync: вместе с данными устойчивыми должны стать и права
+// временного файла.
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace durable {
+
+// Со стольких файлов на одной файловой системе выгоднее syncfs.
+constexpr std::size_t syncfs_threshold = 16;
+
+class Batch {
+public:
+  Batch() = default;
+  Batch(const Batch &) = delete;
+  Batch &operator=(const Batch &) = delete;
+
+  // Незавершенная группа отменяется.
+  ~Batch() { discard(); }
+
+  // Создает временный файл для path в том же каталоге, чтобы
+  // переименование было атомарным. Имя ".имя.XXXXXX" уникально (mkstemp)
+  // и не затирает чужих файлов; права исходного файла ставятся сразу, до
+  // записи данных. Возвращает дескриптор для записи и имя в temp; -1 и
+  // описание в error при ошибке.
+  static int create_temp(const std::string &path, std::string &temp,
+                         std::string *error = nullptr) {
+    struct stat original;
+    if (::stat(path.c_str(), &original) != 0) {
+      fail(error, path);
+      return -1;
+    }
+    std::size_t name = path.rfind('/') + 1; // 0, если каталога в пути нет
+    temp = path.substr(0, name) + "." + path.substr(name) + ".XXXXXX";
+    int fd = ::mkostemp(&temp[0], O_CLOEXEC);
+    if (fd < 0) {
+      fail(error, temp);
+      return -1;
+    }
+    if (::fchmod(fd, original.st_mode & 07777) != 0) {
+      fail(error, temp);
+      ::close(fd);
+      std::remove(temp.c_str());
+      return -1;
+    }
+    return fd;
+  }
+
+  // Записанный и закрытый временный файл temp (из create_temp) заменит
+  // path при commit(). Если тот же файл уже есть в группе (например, указан
+  // дважды или под другим именем), temp не нужен и удаляется. При ошибке
+  // temp удаляется; false и описание в error.
+  bool add(const std::string &path, const std::string &temp,
+           std::string *error = nullptr) {
+    struct stat original;
+    struct stat written;
+    if (::stat(path.c_str(), &original) != 0 ||
+        ::stat(temp.c_str(), &written) != 0) {
+      fail(error, temp);
+      std::remove(temp.c_str());
+      return false;
+    }
+    if (!files_.insert({original.st_dev, original.st_ino}).second) {
+      std::remove(temp.c_str());
+      return true;
+    }
+    entries_.push_back({path, temp, written.st_dev});
+    return true;
+  }
+
+  std::size_t size() const { return entries_.size(); }
+
+  // Отмена группы: временные файлы удаляются.
+  void discard() {
+    for (const Entry &entry : entries_) {
+      std::remove(entry.temp.c_str());
+    }
+    entries_.clear();
+    files_.clear();
+  }
+
+  // Делает временные файлы устойчивыми, переименовывает их и
+  // синхронизирует каталоги. Если синхронизация не удалась, ни один файл
+  // не заменен. Ошибка переименования одного файла не мешает остальным.
+  // false и описание первой ошибки в error.
+  bool commit(std::string *error = nullptr) {
+    bool ok = sync_files(error);
+    if (!ok) {
+      discard();
+      return false;
+    }
+    std::set<std::string> directories;
+    for (const Entry &entry : entries_) {
+      if (std::rename(entry.temp.c_str(), entry.path.c_str()) != 0) {
+        ok = fail(error, entry.path);
+        std::remove(entry.temp.c_str());
+        continue;
+      }
+      directories.insert(directory_of(entry.path));
+    }
+    entries_.clear();
+    files_.clear();
+    for (const std::string &directory : directories) {
+      int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (fd < 0 || ::fsync(fd) != 0) {
+        ok = fail(error, directory);
+      }
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    return ok;
+  }
+
+private:
+  struct Entry {
+    std::string path;
+    std::string temp;
+    dev_t device;
+  };
+
+  // Запоминает первую ошибку; всегда false.
+  static bool fail(std::string *error, const std::string &path) {
+    if (error && error->empty()) {
+      *error = path + ": " + std::strerror(errno);
+    }
+    return false;
+  }
+
+  static std::string directory_of(const std::string &path) {
+    std::size_t slash = path.rfind('/');
+    if (slash == std::string::npos) {
+      return ".";
+    }
+    return slash == 0 ? "/" : path.substr(0, slash);
+  }
+
+  bool sync_files(std::string *error) {
+    std::map<dev_t, std::size_t> per_device;
+    for (const Entry &entry : entries_) {
+      ++per_device[entry.device];
+    }
+
+    // Большие группы: один syncfs на файловую систему.
+    std::set<dev_t> synced;
+    for (const Entry &entry : entries_) {
+      if (per_device[entry.device] < syncfs_threshold ||
+          synced.count(entry.device)) {
+        continue;
+      }
+      int fd = ::open(entry.temp.c_str(), O_RDONLY | O_CLOEXEC);
+      bool ok = fd >= 0 && ::syncfs(fd) == 0;
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      if (!ok) {
+        return fail(error, entry.temp);
+      }
+      synced.insert(entry.device);
+    }
+
+    // Остальные: сначала запуск записи всех файлов, затем ожидание.
+    for (int pass = 0; pass < 2; ++pass) {
+      for (const Entry &entry : entries_) {
+        if (synced.count(entry.device)) {
+          continue;
+        }
+        int fd = ::open(entry.temp.c_str(), O_RDONLY | O_CLOEXEC);
+        bool ok = fd >= 0;
+        if (ok && pass == 0) {
+          // Только подсказка: ошибки проявятся в fsync.
+          ::sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+        } else if (ok) {
+          ok = ::fsync(fd) == 0;
+        }
+        if (fd >= 0) {
+          ::close(fd);
+        }
+        if (!ok) {
+          return fail(error, entry.temp);
+        }
+      }
+    }
+    return true;
+  }
+
+  std::vector<Entry> entries_;
+  std::set<std::pair<dev_t, ino_t>> files_; // исходные файлы группы
+};
+
+} // namespace durable
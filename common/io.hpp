@@ -0,0 +1,738 @@
+#pragma once
+
+// Потоковый ввод-вывод блоками с прозрачным сжатием.
+// Сжатый вход (gzip, zstd) распознается по сигнатуре и распаковывается
+// по мере чтения прямо в буфер автомата; выход сжимается по мере записи,
+// если имя файла оканчивается на .gz или .zst. Память ограничена
+// буферами фиксированного размера, временные файлы не создаются.
+// Имя "-" означает stdin/stdout.
+//
+// Поддержка сжатия подключается при сборке:
+//   gzip: -DTPL_HAVE_ZLIB -lz
+//   zstd: -DTPL_HAVE_ZSTD -lzstd
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef TPL_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef TPL_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace io {
+
+enum class Compression { NONE, GZIP, ZSTD };
+
+constexpr std::size_t block_size = 1 << 16;
+
+inline Compression compression_from_name(std::string_view path) {
+  auto ends_with = [&](std::string_view suffix) {
+    return path.size() >= suffix.size() &&
+           path.substr(path.size() - suffix.size()) == suffix;
+  };
+  if (ends_with(".gz")) {
+    return Compression::GZIP;
+  }
+  if (ends_with(".zst")) {
+    return Compression::ZSTD;
+  }
+  return Compression::NONE;
+}
+
+// Сжатие по сигнатуре начала файла.
+inline Compression detect_compression(std::string_view magic) {
+  if (magic.size() >= 2 && magic[0] == '\x1f' && magic[1] == '\x8b') {
+    return Compression::GZIP;
+  }
+  if (magic.substr(0, 4) == std::string_view("\x28\xb5\x2f\xfd", 4)) {
+    return Compression::ZSTD;
+  }
+  return Compression::NONE;
+}
+
+class Input {
+public:
+  virtual ~Input() = default;
+
+  // Читает до n байт; 0 - конец входа или ошибка (см. error()).
+  virtual std::size_t read(char *buf, std::size_t n) = 0;
+
+  Compression compression() const { return compression_; }
+  const std::string &error() const { return error_; }
+
+protected:
+  Compression compression_ = Compression::NONE;
+  std::string error_;
+};
+
+class FdInput : public Input {
+public:
+  FdInput(int fd, bool owned) : fd_(fd), owned_(owned) {}
+  ~FdInput() override {
+    if (owned_) {
+      ::close(fd_);
+    }
+  }
+
+  std::size_t read(char *buf, std::size_t n) override {
+    if (pos_ < peeked_.size()) {
+      std::size_t k = std::min(n, peeked_.size() - pos_);
+      std::memcpy(buf, peeked_.data() + pos_, k);
+      pos_ += k;
+      return k;
+    }
+    return raw_read(buf, n);
+  }
+
+  // Первые байты входа для распознавания сигнатуры; read их вернет снова.
+  std::string_view peek(std::size_t n) {
+    peeked_.resize(n);
+    std::size_t got = 0;
+    while (got < n) {
+      std::size_t k = raw_read(&peeked_[got], n - got);
+      if (k == 0) {
+        break;
+      }
+      got += k;
+    }
+    peeked_.resize(got);
+    return peeked_;
+  }
+
+  int fd() const { return fd_; }
+
+private:
+  std::size_t raw_read(char *buf, std::size_t n) {
+    for (;;) {
+      ssize_t k = ::read(fd_, buf, n);
+      if (k >= 0) {
+        return static_cast<std::size_t>(k);
+      }
+      if (errno != EINTR) {
+        error_ = std::strerror(errno);
+        return 0;
+      }
+    }
+  }
+
+  int fd_;
+  bool owned_;
+  std::string peeked_;
+  std::size_t pos_ = 0;
+};
+
+#ifdef TPL_HAVE_ZLIB
+class GzipInput : public Input {
+public:
+  explicit GzipInput(std::unique_ptr<Input> source)
+      : source_(std::move(source)), buf_(block_size) {
+    compression_ = Compression::GZIP;
+    // 15 + 32: окно 32 КБ, заголовок gzip или zlib определяется сам.
+    if (inflateInit2(&z_, 15 + 32) != Z_OK) {
+      error_ = "inflateInit2 failed";
+      done_ = true;
+    }
+  }
+  ~GzipInput() override { inflateEnd(&z_); }
+
+  std::size_t read(char *buf, std::size_t n) override {
+    z_.next_out = reinterpret_cast<Bytef *>(buf);
+    z_.avail_out = static_cast<uInt>(n);
+    while (!done_ && z_.avail_out == n) {
+      if (z_.avail_in == 0) {
+        std::size_t k = source_->read(buf_.data(), buf_.size());
+        if (k == 0) {
+          if (!source_->error().empty()) {
+            error_ = source_->error();
+          } else if (in_member_) {
+            error_ = "unexpected end of gzip stream";
+          }
+          done_ = true;
+          break;
+        }
+        z_.next_in = reinterpret_cast<Bytef *>(buf_.data());
+        z_.avail_in = static_cast<uInt>(k);
+      }
+      in_member_ = true;
+      int rc = inflate(&z_, Z_NO_FLUSH);
+      if (rc == Z_STREAM_END) {
+        // Файл может состоять из нескольких склеенных членов gzip.
+        inflateReset(&z_);
+        in_member_ = false;
+      } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+        error_ = z_.msg ? z_.msg : "gzip stream is corrupt";
+        done_ = true;
+      }
+    }
+    return n - z_.avail_out;
+  }
+
+private:
+  std::unique_ptr<Input> source_;
+  std::vector<char> buf_;
+  z_stream z_{};
+  bool in_member_ = false;
+  bool done_ = false;
+};
+#endif
+
+#ifdef TPL_HAVE_ZSTD
+class ZstdInput : public Input {
+public:
+  explicit ZstdInput(std::unique_ptr<Input> source)
+      : source_(std::move(source)), buf_(ZSTD_DStreamInSize()),
+        z_(ZSTD_createDStream()) {
+    compression_ = Compression::ZSTD;
+    if (!z_) {
+      error_ = "ZSTD_createDStream failed";
+      done_ = true;
+      return;
+    }
+    std::size_t rc = ZSTD_initDStream(z_);
+    if (ZSTD_isError(rc)) {
+      error_ = ZSTD_getErrorName(rc);
+      done_ = true;
+    }
+  }
+  ~ZstdInput() override { ZSTD_freeDStream(z_); }
+
+  std::size_t read(char *buf, std::size_t n) override {
+    ZSTD_outBuffer out{buf, n, 0};
+    while (!done_ && out.pos == 0) {
+      if (in_.pos == in_.size) {
+        std::size_t k = source_->read(buf_.data(), buf_.size());
+        if (k == 0) {
+          if (!source_->error().empty()) {
+            error_ = source_->error();
+          } else if (pending_) {
+            error_ = "unexpected end of zstd stream";
+          }
+          done_ = true;
+          break;
+        }
+        in_ = ZSTD_inBuffer{buf_.data(), k, 0};
+      }
+      std::size_t rc = ZSTD_decompressStream(z_, &out, &in_);
+      if (ZSTD_isError(rc)) {
+        error_ = ZSTD_getErrorName(rc);
+        done_ = true;
+      }
+      pending_ = rc != 0;
+    }
+    return out.pos;
+  }
+
+private:
+  std::unique_ptr<Input> source_;
+  std::vector<char> buf_;
+  ZSTD_DStream *z_;
+  ZSTD_inBuffer in_{nullptr, 0, 0};
+  bool pending_ = false;
+  bool done_ = false;
+};
+#endif
+
+// Открывает файл (или stdin для "-") и, если он сжат, подключает
+// распаковку. При ошибке возвращает nullptr и описание в error.
+inline std::unique_ptr<Input> open_input(const std::string &path,
+                                         std::string *error = nullptr) {
+  auto fail = [&](std::string message) -> std::unique_ptr<Input> {
+    if (error) {
+      *error = std::move(message);
+    }
+    return nullptr;
+  };
+
+  bool is_stdin = path == "-";
+  int fd = is_stdin ? 0 : ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return fail(std::strerror(errno));
+  }
+  auto raw = std::make_unique<FdInput>(fd, !is_stdin);
+  switch (detect_compression(raw->peek(4))) {
+  case Compression::GZIP:
+#ifdef TPL_HAVE_ZLIB
+    return std::make_unique<GzipInput>(std::move(raw));
+#else
+    return fail("gzip support is not compiled in");
+#endif
+  case Compression::ZSTD:
+#ifdef TPL_HAVE_ZSTD
+    return std::make_unique<ZstdInput>(std::move(raw));
+#else
+    return fail("zstd support is not compiled in");
+#endif
+  default:
+    return raw;
+  }
+}
+
+// Обычный файл, отображенный в память только для чтения. Для пустых,
+// сжатых и не обычных файлов (каналы, устройства) valid() == false.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path) {
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd_ < 0 || ::fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode) ||
+        st.st_size == 0) {
+      return;
+    }
+    void *p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ,
+                     MAP_PRIVATE, fd_, 0);
+    if (p == MAP_FAILED) {
+      return;
+    }
+    data_ = {static_cast<const char *>(p), static_cast<std::size_t>(st.st_size)};
+    if (detect_compression(data_) != Compression::NONE) {
+      unmap();
+    }
+  }
+  ~MappedFile() {
+    unmap();
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool valid() const { return data_.data() != nullptr; }
+  std::string_view data() const { return data_; }
+  int fd() const { return fd_; }
+
+private:
+  void unmap() {
+    if (data_.data()) {
+      ::munmap(const_cast<char *>(data_.data()), data_.size());
+      data_ = {};
+    }
+  }
+
+  int fd_ = -1;
+  std::string_view data_;
+};
+
+// Наблюдатель за записью (например, для замеров по фазам работы).
+class WriteObserver {
+public:
+  virtual ~WriteObserver() = default;
+  virtual void before_write() = 0;
+  virtual void after_write() = 0;
+};
+
+// Буферизованный выход; годится как приемник для strip::Stripper.
+class Output {
+public:
+  virtual ~Output() = default;
+
+  void put(char c) {
+    if (buf_.size() == block_size) {
+      flush();
+    }
+    buf_.push_back(c);
+  }
+
+  void write(const char *p, std::size_t n) {
+    if (buf_.size() + n > block_size) {
+      flush();
+      if (n >= block_size) {
+        ok_ = ok_ && observed_sink(p, n);
+        return;
+      }
+    }
+    buf_.append(p, n);
+  }
+
+  void flush() {
+    if (!buf_.empty()) {
+      ok_ = ok_ && observed_sink(buf_.data(), buf_.size());
+      buf_.clear();
+    }
+  }
+
+  void set_observer(WriteObserver *observer) { observer_ = observer; }
+
+  // Дописывает буфер и завершает поток; false при любой ошибке записи.
+  virtual bool close() {
+    flush();
+    return ok_;
+  }
+
+  const std::string &error() const { return error_; }
+
+protected:
+  Output() { buf_.reserve(block_size); }
+
+  virtual bool sink(const char *p, std::size_t n) = 0;
+
+  // Охватывает запись для наблюдателя (вложенные охваты допустимы).
+  class Observed {
+  public:
+    explicit Observed(WriteObserver *observer) : observer_(observer) {
+      if (observer_) {
+        observer_->before_write();
+      }
+    }
+    ~Observed() {
+      if (observer_) {
+        observer_->after_write();
+      }
+    }
+
+  private:
+    WriteObserver *observer_;
+  };
+
+  bool observed_sink(const char *p, std::size_t n) {
+    Observed scope(observer_);
+    return sink(p, n);
+  }
+
+  std::string buf_;
+  bool ok_ = true;
+  std::string error_;
+  WriteObserver *observer_ = nullptr;
+};
+
+class FdOutput : public Output {
+public:
+  FdOutput(int fd, bool owned) : fd_(fd), owned_(owned) {}
+  ~FdOutput() override { FdOutput::close(); }
+
+  bool close() override {
+    bool ok = Output::close();
+    if (owned_ && fd_ >= 0) {
+      if (::close(fd_) != 0 && ok) {
+        error_ = std::strerror(errno);
+        ok_ = ok = false;
+      }
+      fd_ = -1;
+    }
+    return ok;
+  }
+
+  int fd() const { return fd_; }
+
+  // Переносит до n байт файла in_fd со смещения offset прямо в выход, минуя
+  // пользовательское пространство: copy_file_range, а если выход - канал,
+  // splice. Возвращает число перенесенных байт; если ядро не умеет переноса
+  // для этой пары файлов, остаток надо записать обычным путем.
+  std::size_t transfer(int in_fd, std::uint64_t offset, std::size_t n) {
+    flush();
+    Observed scope(observer_);
+    std::size_t done = 0;
+    while (ok_ && done < n && (copy_ok_ || splice_ok_)) {
+      auto off = static_cast<loff_t>(offset + done);
+      ssize_t k = copy_ok_ ? ::copy_file_range(in_fd, &off, fd_, nullptr,
+                                               n - done, 0)
+                           : ::splice(in_fd, &off, fd_, nullptr, n - done, 0);
+      if (k > 0) {
+        done += static_cast<std::size_t>(k);
+      } else if (k == 0) {
+        break;
+      } else if (errno == EINTR) {
+        continue;
+      } else if (errno == EINVAL || errno == EXDEV || errno == ENOSYS ||
+                 errno == EOPNOTSUPP || errno == EBADF) {
+        // Перенос не поддерживается: пробуем следующий способ
+        (copy_ok_ ? copy_ok_ : splice_ok_) = false;
+      } else {
+        error_ = std::strerror(errno);
+        ok_ = false;
+      }
+    }
+    return done;
+  }
+
+  bool sink(const char *p, std::size_t n) override {
+    while (n > 0) {
+      ssize_t k = ::write(fd_, p, n);
+      if (k < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        error_ = std::strerror(errno);
+        return false;
+      }
+      p += k;
+      n -= static_cast<std::size_t>(k);
+    }
+    return true;
+  }
+
+private:
+  int fd_;
+  bool owned_;
+  bool copy_ok_ = true;
+  bool splice_ok_ = true;
+};
+
+// Приемник для strip::Stripper, который переносит длинные неизмененные
+// участки отображенного входа через FdOutput::transfer. Участок узнается
+// по указателю: запись из памяти отображения, идущая сразу за текущим
+// участком, продолжает его. Короткие участки (меньше min_span) и все
+// остальное идут через буфер выхода.
+class SpanSink {
+public:
+  SpanSink(const MappedFile &in, FdOutput &out, std::size_t min_span)
+      : in_(in), out_(out), min_span_(min_span) {}
+
+  void put(char c) {
+    settle();
+    out_.put(c);
+  }
+
+  void write(const char *p, std::size_t n) {
+    std::string_view data = in_.data();
+    if (p < data.data() || p >= data.data() + data.size()) {
+      settle();
+      out_.write(p, n);
+      return;
+    }
+    if (span_ && p == span_ + span_size_) {
+      span_size_ += n;
+      return;
+    }
+    settle();
+    span_ = p;
+    span_size_ = n;
+  }
+
+  // Выводит последний участок; вызывается после Stripper::finish.
+  void finish() { settle(); }
+
+  std::uint64_t transferred() const { return transferred_; }
+
+private:
+  void settle() {
+    if (!span_) {
+      return;
+    }
+    std::size_t done = 0;
+    if (span_size_ >= min_span_) {
+      done = out_.transfer(in_.fd(),
+                           static_cast<std::uint64_t>(span_ - in_.data().data()),
+                           span_size_);
+      transferred_ += done;
+    }
+    out_.write(span_ + done, span_size_ - done);
+    span_ = nullptr;
+  }
+
+  const MappedFile &in_;
+  FdOutput &out_;
+  std::size_t min_span_;
+  const char *span_ = nullptr;
+  std::size_t span_size_ = 0;
+  std::uint64_t transferred_ = 0;
+};
+
+#ifdef TPL_HAVE_ZLIB
+class GzipOutput : public Output {
+public:
+  explicit GzipOutput(std::unique_ptr<FdOutput> target)
+      : target_(std::move(target)), zbuf_(block_size) {
+    // 15 + 16: окно 32 КБ с заголовком gzip.
+    if (deflateInit2(&z_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      error_ = "deflateInit2 failed";
+      ok_ = false;
+    }
+  }
+  ~GzipOutput() override {
+    GzipOutput::close();
+    deflateEnd(&z_);
+  }
+
+  bool close() override {
+    if (!closed_) {
+      closed_ = true;
+      Observed scope(observer_);
+      Output::close();
+      ok_ = ok_ && deflate_all(nullptr, 0, Z_FINISH);
+      ok_ = target_->close() && ok_;
+      if (error_.empty()) {
+        error_ = target_->error();
+      }
+    }
+    return ok_;
+  }
+
+protected:
+  bool sink(const char *p, std::size_t n) override {
+    return deflate_all(p, n, Z_NO_FLUSH);
+  }
+
+private:
+  bool deflate_all(const char *p, std::size_t n, int flush) {
+    z_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(p));
+    z_.avail_in = static_cast<uInt>(n);
+    int rc;
+    do {
+      z_.next_out = reinterpret_cast<Bytef *>(zbuf_.data());
+      z_.avail_out = static_cast<uInt>(zbuf_.size());
+      rc = deflate(&z_, flush);
+      if (rc == Z_STREAM_ERROR) {
+        error_ = "deflate failed";
+        return false;
+      }
+      if (!target_->sink(zbuf_.data(), zbuf_.size() - z_.avail_out)) {
+        return false;
+      }
+    } while (z_.avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+    return true;
+  }
+
+  std::unique_ptr<FdOutput> target_;
+  std::vector<char> zbuf_;
+  z_stream z_{};
+  bool closed_ = false;
+};
+#endif
+
+#ifdef TPL_HAVE_ZSTD
+class ZstdOutput : public Output {
+public:
+  explicit ZstdOutput(std::unique_ptr<FdOutput> target)
+      : target_(std::move(target)), zbuf_(ZSTD_CStreamOutSize()),
+        z_(ZSTD_createCStream()) {
+    if (!z_) {
+      error_ = "ZSTD_createCStream failed";
+      ok_ = false;
+      return;
+    }
+    std::size_t rc = ZSTD_initCStream(z_, 3);
+    if (ZSTD_isError(rc)) {
+      error_ = ZSTD_getErrorName(rc);
+      ok_ = false;
+    }
+  }
+  ~ZstdOutput() override {
+    ZstdOutput::close();
+    ZSTD_freeCStream(z_);
+  }
+
+  bool close() override {
+    if (!closed_) {
+      closed_ = true;
+      Observed scope(observer_);
+      Output::close();
+      // После ошибки, в том числе в конструкторе, поток не завершается.
+      while (ok_) {
+        ZSTD_outBuffer out{zbuf_.data(), zbuf_.size(), 0};
+        std::size_t rc = ZSTD_endStream(z_, &out);
+        if (ZSTD_isError(rc)) {
+          error_ = ZSTD_getErrorName(rc);
+          ok_ = false;
+          break;
+        }
+        ok_ = target_->sink(zbuf_.data(), out.pos);
+        if (rc == 0) {
+          break;
+        }
+      }
+      ok_ = target_->close() && ok_;
+      if (error_.empty()) {
+        error_ = target_->error();
+      }
+    }
+    return ok_;
+  }
+
+protected:
+  bool sink(const char *p, std::size_t n) override {
+    ZSTD_inBuffer in{p, n, 0};
+    while (in.pos < in.size) {
+      ZSTD_outBuffer out{zbuf_.data(), zbuf_.size(), 0};
+      std::size_t rc = ZSTD_compressStream(z_, &out, &in);
+      if (ZSTD_isError(rc)) {
+        error_ = ZSTD_getErrorName(rc);
+        return false;
+      }
+      if (!target_->sink(zbuf_.data(), out.pos)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  std::unique_ptr<FdOutput> target_;
+  std::vector<char> zbuf_;
+  ZSTD_CStream *z_;
+  bool closed_ = false;
+};
+#endif
+
+// Выход в уже открытый файл raw со сжатием compression; поддержка
+// сжатия должна быть собрана.
+inline std::unique_ptr<Output>
+compressed_output(std::unique_ptr<FdOutput> raw, Compression compression) {
+  switch (compression) {
+#ifdef TPL_HAVE_ZLIB
+  case Compression::GZIP:
+    return std::make_unique<GzipOutput>(std::move(raw));
+#endif
+#ifdef TPL_HAVE_ZSTD
+  case Compression::ZSTD:
+    return std::make_unique<ZstdOutput>(std::move(raw));
+#endif
+  default:
+    return raw;
+  }
+}
+
+// Создает файл (или stdout для "-"); сжатие по умолчанию выбирается по
+// расширению имени. При ошибке возвращает nullptr и описание в error.
+inline std::unique_ptr<Output> open_output(const std::string &path,
+                                           Compression compression,
+                                           std::string *error = nullptr) {
+  auto fail = [&](std::string message) -> std::unique_ptr<Output> {
+    if (error) {
+      *error = std::move(message);
+    }
+    return nullptr;
+  };
+
+#ifndef TPL_HAVE_ZLIB
+  if (compression == Compression::GZIP) {
+    return fail("gzip support is not compiled in");
+  }
+#endif
+#ifndef TPL_HAVE_ZSTD
+  if (compression == Compression::ZSTD) {
+    return fail("zstd support is not compiled in");
+  }
+#endif
+
+  bool is_stdout = path == "-";
+  int fd = is_stdout ? 1
+                     : ::open(path.c_str(),
+                              O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd < 0) {
+    return fail(std::strerror(errno));
+  }
+  return compressed_output(std::make_unique<FdOutput>(fd, !is_stdout),
+                           compression);
+}
+
+inline std::unique_ptr<Output> open_output(const std::string &path,
+                                           std::string *error = nullptr) {
+  return open_output(path, compression_from_name(path), error);
+}
+
+} // namespace io
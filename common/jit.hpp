@@ -0,0 +1,358 @@
+#pragma once
+
+// Компиляция автомата strip.hpp в машинный код x86-64 (Lab1/2.cpp --jit).
+// Для политики строится функция
+//   size_t f(const char *in, size_t n, char *out, int *state),
+// в которой каждое состояние - участок кода, а переход - переход на его
+// адрес: байт читается, сравнивается с особыми символами состояния, и
+// управление уходит прямо в код следующего состояния, без загрузки
+// таблицы и без switch. Состояние (значение strip::State) сохраняется в
+// *state между вызовами, поэтому вход, как и у strip::Stripper, можно
+// подавать частями.
+//
+// Код пишется в страницы mmap, которые после записи переводятся в режим
+// чтения и исполнения. Поддерживаются политики без #if 0 и без сжатия
+// пробелов; на других платформах или при ошибке mmap compiled() возвращает
+// nullptr, и используется обычный автомат.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define TPL_HAVE_JIT 1
+#endif
+
+#include "strip.hpp"
+
+namespace jit {
+
+using Function = std::size_t (*)(const char *in, std::size_t n, char *out,
+                                 int *state);
+
+// Исполняемая копия машинного кода.
+class Code {
+public:
+  Code(const Code &) = delete;
+  Code &operator=(const Code &) = delete;
+
+  ~Code() {
+#ifdef TPL_HAVE_JIT
+    munmap(page_, size_);
+#endif
+  }
+
+  Function function() const { return function_; }
+
+  // Копия bytes в исполняемой памяти или nullptr.
+  static std::unique_ptr<Code> load(const std::vector<unsigned char> &bytes) {
+#ifdef TPL_HAVE_JIT
+    void *page = mmap(nullptr, bytes.size(), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+      return nullptr;
+    }
+    std::memcpy(page, bytes.data(), bytes.size());
+    if (mprotect(page, bytes.size(), PROT_READ | PROT_EXEC) != 0) {
+      munmap(page, bytes.size());
+      return nullptr;
+    }
+    return std::unique_ptr<Code>(new Code(page, bytes.size()));
+#else
+    (void)bytes;
+    return nullptr;
+#endif
+  }
+
+private:
+  Code(void *page, std::size_t size) : page_(page), size_(size) {
+    function_ = reinterpret_cast<Function>(page);
+  }
+
+  void *page_;
+  std::size_t size_;
+  Function function_ = nullptr;
+};
+
+// Минимальный ассемблер: байты инструкций и переходы rel32 на метки.
+class Assembler {
+public:
+  int label() {
+    labels_.push_back(0);
+    return static_cast<int>(labels_.size() - 1);
+  }
+
+  void bind(int label) { labels_[label] = code_.size(); }
+
+  void emit(std::initializer_list<unsigned char> bytes) {
+    code_.insert(code_.end(), bytes);
+  }
+
+  void emit32(std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+      code_.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+  }
+
+  void jmp(int label) {
+    emit({0xE9});
+    fixup(label);
+  }
+  void je(int label) {
+    emit({0x0F, 0x84});
+    fixup(label);
+  }
+  void jne(int label) {
+    emit({0x0F, 0x85});
+    fixup(label);
+  }
+
+  // Код с подставленными адресами переходов.
+  std::vector<unsigned char> finish() {
+    for (auto [at, label] : fixups_) {
+      auto rel = static_cast<std::uint32_t>(labels_[label] - (at + 4));
+      for (int i = 0; i < 4; ++i) {
+        code_[at + i] = static_cast<unsigned char>(rel >> (8 * i));
+      }
+    }
+    return code_;
+  }
+
+private:
+  void fixup(int label) {
+    fixups_.push_back({code_.size(), label});
+    emit32(0);
+  }
+
+  std::vector<unsigned char> code_;
+  std::vector<std::size_t> labels_;
+  std::vector<std::pair<std::size_t, int>> fixups_;
+};
+
+// Генерация кода для политики P. Регистры: rdi - текущий байт входа,
+// rsi - конец входа, rdx - текущая позиция выхода, r8 - начало выхода,
+// rcx - указатель на состояние, al - прочитанный байт.
+template <class P> std::vector<unsigned char> generate() {
+  static_assert(!P::skip_disabled && !P::minify,
+                "jit: #if 0 and minify are not supported");
+  using strip::State;
+  constexpr int states = strip::SLASH_IN_CHAR + 1;
+
+  Assembler a;
+  int entry[states];
+  int exit[states];
+  for (int s = 0; s < states; ++s) {
+    entry[s] = a.label();
+    exit[s] = a.label();
+  }
+  int done = a.label();
+
+  auto at_end = [&](State s) {
+    a.emit({0x48, 0x39, 0xF7}); // cmp rdi, rsi
+    a.je(exit[s]);
+  };
+  auto load = [&]() { a.emit({0x0F, 0xB6, 0x07}); }; // movzx eax, byte [rdi]
+  auto next = [&]() { a.emit({0x48, 0xFF, 0xC7}); }; // inc rdi
+  auto store = [&]() {
+    a.emit({0x88, 0x02});       // mov [rdx], al
+    a.emit({0x48, 0xFF, 0xC2}); // inc rdx
+  };
+  auto store_char = [&](char c) {
+    a.emit({0xC6, 0x02, static_cast<unsigned char>(c)}); // mov byte [rdx], c
+    a.emit({0x48, 0xFF, 0xC2});                          // inc rdx
+  };
+  auto is = [&](char c) {
+    a.emit({0x3C, static_cast<unsigned char>(c)}); // cmp al, c
+  };
+
+  // Пролог: rsi = in + n, r8 = out, переход в код сохраненного состояния.
+  a.emit({0x48, 0x8D, 0x34, 0x37}); // lea rsi, [rdi + rsi]
+  a.emit({0x49, 0x89, 0xD0});       // mov r8, rdx
+  a.emit({0x8B, 0x01});             // mov eax, [rcx]
+  for (int s = 0; s < states; ++s) {
+    a.emit({0x83, 0xF8, static_cast<unsigned char>(s)}); // cmp eax, s
+    a.je(entry[s]);
+  }
+  a.jmp(entry[strip::NORMAL]);
+
+  // NORMAL: '/' откладывается, остальное выводится; кавычка открывает
+  // строку или символ.
+  a.bind(entry[strip::NORMAL]);
+  at_end(strip::NORMAL);
+  load();
+  next();
+  is('/');
+  a.je(entry[strip::SLASH]);
+  store();
+  if constexpr (P::strings) {
+    is('"');
+    a.je(entry[strip::IN_STRING]);
+    is('\'');
+    a.je(entry[strip::IN_CHAR]);
+  }
+  a.jmp(entry[strip::NORMAL]);
+
+  // SLASH: следующий байт решает, комментарий ли это.
+  a.bind(entry[strip::SLASH]);
+  at_end(strip::SLASH);
+  load();
+  int not_star = a.label();
+  is('*');
+  a.jne(not_star);
+  next();
+  a.jmp(entry[strip::MULTI_COMMENT]);
+  a.bind(not_star);
+  int not_slash = a.label();
+  is('/');
+  a.jne(not_slash);
+  next();
+  if constexpr (P::line_comments) {
+    a.jmp(entry[strip::SINGLE_COMMENT]);
+  } else {
+    // Первый '/' выводится, второй снова ждет продолжения.
+    store_char('/');
+    a.jmp(entry[strip::SLASH]);
+  }
+  a.bind(not_slash);
+  // Это был не комментарий: байт разбирается заново в NORMAL.
+  store_char('/');
+  a.jmp(entry[strip::NORMAL]);
+
+  // MULTI_COMMENT: поиск '*'.
+  a.bind(entry[strip::MULTI_COMMENT]);
+  at_end(strip::MULTI_COMMENT);
+  load();
+  next();
+  is('*');
+  a.jne(entry[strip::MULTI_COMMENT]);
+
+  // STAR_IN_MULTI_COMMENT: '/' закрывает комментарий.
+  a.bind(entry[strip::STAR_IN_MULTI_COMMENT]);
+  at_end(strip::STAR_IN_MULTI_COMMENT);
+  load();
+  next();
+  int not_close = a.label();
+  is('/');
+  a.jne(not_close);
+  if constexpr (P::comment_to_space) {
+    store_char(' ');
+  }
+  a.jmp(entry[strip::NORMAL]);
+  a.bind(not_close);
+  is('*');
+  a.je(entry[strip::STAR_IN_MULTI_COMMENT]);
+  a.jmp(entry[strip::MULTI_COMMENT]);
+
+  // SINGLE_COMMENT: до перевода строки, который выводится.
+  a.bind(entry[strip::SINGLE_COMMENT]);
+  at_end(strip::SINGLE_COMMENT);
+  load();
+  next();
+  int line_end = a.label();
+  is('\n');
+  a.je(line_end);
+  is('\r');
+  a.jne(entry[strip::SINGLE_COMMENT]);
+  a.bind(line_end);
+  store();
+  a.jmp(entry[strip::NORMAL]);
+
+  // IN_STRING, IN_CHAR и экранированный символ в них.
+  auto quoted = [&](State in, State escape, char quote) {
+    a.bind(entry[in]);
+    at_end(in);
+    load();
+    next();
+    store();
+    is(quote);
+    a.je(entry[strip::NORMAL]);
+    is('\\');
+    a.jne(entry[in]);
+    a.bind(entry[escape]);
+    at_end(escape);
+    load();
+    next();
+    store();
+    a.jmp(entry[in]);
+  };
+  if constexpr (P::strings) {
+    quoted(strip::IN_STRING, strip::SLASH_IN_STRING, '"');
+    quoted(strip::IN_CHAR, strip::SLASH_IN_CHAR, '\'');
+  } else {
+    for (State s : {strip::IN_STRING, strip::SLASH_IN_STRING, strip::IN_CHAR,
+                    strip::SLASH_IN_CHAR}) {
+      a.bind(entry[s]);
+      a.jmp(entry[strip::NORMAL]);
+    }
+  }
+
+  // Выходы: состояние сохраняется, возвращается длина выхода.
+  for (int s = 0; s < states; ++s) {
+    a.bind(exit[s]);
+    a.emit({0xC7, 0x01}); // mov dword [rcx], s
+    a.emit32(static_cast<std::uint32_t>(s));
+    a.jmp(done);
+  }
+  a.bind(done);
+  a.emit({0x48, 0x89, 0xD0}); // mov rax, rdx
+  a.emit({0x4C, 0x29, 0xC0}); // sub rax, r8
+  a.emit({0xC3});             // ret
+  return a.finish();
+}
+
+// Скомпилированный автомат для политики P (один на программу) или
+// nullptr, если компиляция недоступна.
+template <class P> const Code *compiled() {
+#ifdef TPL_HAVE_JIT
+  static const std::unique_ptr<Code> code = Code::load(generate<P>());
+  return code.get();
+#else
+  return nullptr;
+#endif
+}
+
+// Замена strip::Stripper<P> с тем же интерфейсом.
+template <class P> class Stripper {
+public:
+  explicit Stripper(const Code &code) : function_(code.function()) {}
+
+  template <class Sink> void feed(std::string_view in, Sink &out) {
+    // Каждый байт входа дает не больше байта выхода, плюс отложенный '/'.
+    buf_.resize(in.size() + 1);
+    std::size_t n = function_(in.data(), in.size(), buf_.data(), &state_);
+    if (n) {
+      out.write(buf_.data(), n);
+    }
+  }
+
+  template <class Sink> void finish(Sink &out) {
+    if (state_ == strip::SLASH) {
+      out.put('/');
+    }
+    state_ = strip::NORMAL;
+  }
+
+private:
+  Function function_;
+  int state_ = strip::NORMAL;
+  std::vector<char> buf_;
+};
+
+// Как strip::strip_stream, но скомпилированным автоматом.
+template <class P, class Source, class Sink>
+void strip_stream(const Code &code, Source &in, Sink &out, P = {}) {
+  Stripper<P> stripper(code);
+  std::vector<char> buf(1 << 16);
+  while (std::size_t n = in.read(buf.data(), buf.size())) {
+    stripper.feed({buf.data(), n}, out);
+  }
+  stripper.finish(out);
+}
+
+} // namespace jit
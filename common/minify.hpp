@@ -0,0 +1,225 @@
+#pragma once
+
+// Сжатие пробелов для автомата strip.hpp (Lab1/2.cpp --minify).
+// Автомат передает сюда код вне строк и символов, а содержимое строк
+// выводится как есть. Серия пробельных символов (и заменивший комментарий
+// пробел) сжимается до одного пробела, только если без него соседние
+// лексемы слились бы: два слова, слово и кавычка, два знака препинания,
+// экспонента числа и знак. Переводы строк остаются только вокруг
+// директив препроцессора: перед '#' в начале строки и в конце директивы
+// (и после '\' в продолжении директивы). В "#define F (x)" пробел перед
+// '(' остается: без него макрос-объект стал бы макросом-функцией.
+
+#include <cstddef>
+#include <cstring>
+
+namespace minify {
+
+class Minifier {
+public:
+  // Код вне строк и символов.
+  template <class Sink> void code(const char *p, std::size_t n, Sink &out) {
+    const char *end = p + n;
+    while (p != end) {
+      if (is_space(*p)) {
+        space(*p++, out);
+        continue;
+      }
+      const char *q = p + 1;
+      while (q != end && !is_space(*q)) {
+        ++q;
+      }
+      start(*p, out);
+      if (define_ != OTHER) {
+        for (const char *r = p; r != q; ++r) {
+          define_char(*r);
+        }
+      }
+      out.write(p, q - p);
+      last_ = q[-1];
+      escaped_ = last_ == '\\';
+      p = q;
+    }
+  }
+
+  // Содержимое строки или символа (без открывающей кавычки).
+  template <class Sink> void text(const char *p, std::size_t n, Sink &out) {
+    if (n == 0) {
+      return;
+    }
+    out.write(p, n);
+    last_ = p[n - 1];
+    escaped_ = false;
+  }
+
+  // Комментарий, замененный пробелом.
+  void comment() {
+    pending_ = true;
+    define_break();
+  }
+
+  // Конец входа: завершающий перевод строки сохраняется.
+  template <class Sink> void finish(Sink &out) {
+    if (newline_ || directive_) {
+      out.put('\n');
+    }
+    *this = Minifier();
+  }
+
+private:
+  // Где в директиве #define находится разбор.
+  enum Define {
+    OTHER,      // не #define или имя макроса уже позади
+    KEYWORD,    // слово после '#'
+    NAME,       // имя макроса
+    AFTER_NAME, // пробелы после имени
+  };
+
+  static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+           c == '\v';
+  }
+
+  static bool is_word(char c) {
+    return c == '_' || c == '$' || (c >= 'a' && c <= 'z') ||
+           (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           static_cast<unsigned char>(c) >= 0x80;
+  }
+
+  static bool is_quote(char c) { return c == '"' || c == '\''; }
+
+  // Знаки, которые ни с чем не образуют составную лексему.
+  static bool is_single(char c) {
+    switch (c) {
+    case '(':
+    case ')':
+    case '[':
+    case ']':
+    case '{':
+    case '}':
+    case ',':
+    case ';':
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  // Нужен ли пробел между a и b, чтобы лексемы не слились.
+  static bool separate(char a, char b) {
+    if (a == '\n' || is_single(a) || is_single(b)) {
+      return false;
+    }
+    bool a_word = is_word(a) || is_quote(a);
+    bool b_word = is_word(b) || is_quote(b);
+    if (a_word && b_word) {
+      return true;
+    }
+    if (a_word || b_word) {
+      // 1e -1 не должно стать числом 1e-1
+      return (a == 'e' || a == 'E' || a == 'p' || a == 'P') &&
+             (b == '+' || b == '-');
+    }
+    return true;
+  }
+
+  // Очередной символ кода внутри директивы.
+  void define_char(char c) {
+    switch (define_) {
+    case KEYWORD:
+      if (is_word(c)) {
+        if (word_ < sizeof keyword_) {
+          keyword_[word_] = c;
+        }
+        ++word_;
+      } else if (c != '#' || word_ != 0) {
+        define_ = OTHER;
+      }
+      break;
+    case NAME:
+      if (is_word(c)) {
+        ++word_;
+      } else {
+        define_ = OTHER; // "F(" - макрос-функция
+      }
+      break;
+    case AFTER_NAME:
+      // '\' - продолжение директивы, имя отделено от следующей строки
+      if (c != '\\') {
+        define_ = OTHER;
+      }
+      break;
+    case OTHER:
+      break;
+    }
+  }
+
+  // Пробел или комментарий внутри директивы: конец слова.
+  void define_break() {
+    if (word_ == 0) {
+      return;
+    }
+    if (define_ == KEYWORD) {
+      bool define = word_ == 6 && std::memcmp(keyword_, "define", 6) == 0;
+      define_ = define ? NAME : OTHER;
+      word_ = 0;
+    } else if (define_ == NAME) {
+      define_ = AFTER_NAME;
+    }
+  }
+
+  template <class Sink> void space(char c, Sink &out) {
+    if (define_ != OTHER) {
+      define_break();
+    }
+    if (c == '\n' && directive_) {
+      out.put('\n');
+      last_ = '\n';
+      pending_ = false;
+      // Перевод строки после '\' продолжает директиву.
+      directive_ = escaped_;
+      escaped_ = false;
+      if (!directive_) {
+        define_ = OTHER;
+      }
+      line_start_ = !directive_;
+      return;
+    }
+    pending_ = true;
+    if (c == '\n') {
+      newline_ = true;
+      line_start_ = true;
+    }
+  }
+
+  // Перед первым символом серии c после пробелов.
+  template <class Sink> void start(char c, Sink &out) {
+    if (line_start_ && c == '#') {
+      if (last_ != '\n') {
+        out.put('\n');
+      }
+      directive_ = true;
+      define_ = KEYWORD;
+      word_ = 0;
+    } else if (pending_ &&
+               (separate(last_, c) ||
+                (define_ == AFTER_NAME && (c == '(' || c == '\\')))) {
+      out.put(' ');
+    }
+    pending_ = false;
+    newline_ = false;
+    line_start_ = false;
+  }
+
+  char last_ = '\n';        // последний выведенный символ
+  bool pending_ = false;    // были пробелы после last_
+  bool newline_ = false;    // среди них был перевод строки
+  bool line_start_ = true;  // в строке входа еще не было кода
+  bool directive_ = false;  // внутри директивы
+  bool escaped_ = false;    // last_ - '\' внутри директивы
+  Define define_ = OTHER;
+  char keyword_[6] = {};    // начало слова после '#'
+  std::size_t word_ = 0;    // длина текущего слова в #define
+};
+
+} // namespace minify
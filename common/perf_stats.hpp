@@ -0,0 +1,239 @@
+#pragma once
+
+// Замеры по фазам работы инструмента (--perf-stats): чтение, автомат,
+// запись. Для каждой фазы накапливаются время и аппаратные счетчики
+// perf_event_open (такты, инструкции, промахи предсказания переходов,
+// промахи последнего уровня кэша); итог выводится в пересчете на мегабайт
+// входа, текстом или в JSON. Если счетчики недоступны (нет прав, ядро или
+// виртуальная машина их не поддерживают), выводится только время.
+//
+// Счетчики наследуются потоками, созданными после Stats, и считают
+// только пользовательский код. В многопоточных режимах фаза определяется
+// главным потоком, поэтому чтение в рабочих потоках входит в фазу
+// automaton.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <string_view>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "io.hpp"
+
+namespace perf {
+
+enum Phase { READ, AUTOMATON, WRITE, PHASE_COUNT };
+enum Counter { CYCLES, INSTRUCTIONS, BRANCH_MISSES, LLC_MISSES, COUNTER_COUNT };
+enum class Format { NONE, TEXT, JSON };
+
+// Разбор --perf-stats[=text|json]; false, если это другой аргумент.
+inline bool parse_option(std::string_view arg, Format &format) {
+  if (arg == "--perf-stats" || arg == "--perf-stats=text") {
+    format = Format::TEXT;
+    return true;
+  }
+  if (arg == "--perf-stats=json") {
+    format = Format::JSON;
+    return true;
+  }
+  return false;
+}
+
+class Stats : public io::WriteObserver {
+public:
+  Stats() {
+    static const std::uint64_t configs[COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof attr);
+      attr.size = sizeof attr;
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[c];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.inherit = 1;
+      fds_[c] = static_cast<int>(
+          ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    }
+    read_counters(last_);
+  }
+
+  ~Stats() override {
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+  Stats(const Stats &) = delete;
+  Stats &operator=(const Stats &) = delete;
+
+  // Переход в фазу p: накопленное с прошлого перехода относится к текущей.
+  void enter(Phase p) {
+    sample();
+    current_ = p;
+  }
+
+  void add_input(std::uint64_t bytes) { input_bytes_ += bytes; }
+
+  // Байты входа, пропущенные без автомата (известные блоки в начале
+  // файлов); входят и в add_input.
+  void add_skipped(std::uint64_t bytes) { skipped_bytes_ += bytes; }
+
+  void before_write() override {
+    if (write_depth_++ == 0) {
+      saved_ = current_;
+      enter(WRITE);
+    }
+  }
+
+  void after_write() override {
+    if (--write_depth_ == 0) {
+      enter(saved_);
+    }
+  }
+
+  bool counters_available() const { return fds_[CYCLES] >= 0; }
+
+  void report(std::ostream &out, Format format) {
+    sample();
+    if (format == Format::JSON) {
+      report_json(out);
+    } else {
+      report_text(out);
+    }
+  }
+
+private:
+  void read_counters(std::uint64_t (&values)[COUNTER_COUNT]) const {
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+      if (fds_[c] >= 0 &&
+          ::read(fds_[c], &values[c], sizeof values[c]) != sizeof values[c]) {
+        values[c] = last_[c];
+      }
+    }
+  }
+
+  void sample() {
+    auto now = std::chrono::steady_clock::now();
+    std::uint64_t values[COUNTER_COUNT] = {};
+    read_counters(values);
+    times_[current_] += static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_time_)
+            .count());
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+      totals_[current_][c] += values[c] - last_[c];
+      last_[c] = values[c];
+    }
+    last_time_ = now;
+  }
+
+  double megabytes() const {
+    return input_bytes_ ? static_cast<double>(input_bytes_) / (1 << 20) : 1.0;
+  }
+
+  void report_text(std::ostream &out) const {
+    static const char *const phase_names[PHASE_COUNT] = {"read", "automaton",
+                                                         "write"};
+    out << "perf-stats: input " << input_bytes_ << " bytes";
+    if (skipped_bytes_) {
+      out << ", " << skipped_bytes_ << " skipped as known boilerplate";
+    }
+    if (!counters_available()) {
+      out << " (hardware counters unavailable, time only)";
+    }
+    out << "\nphase       ms/MB   cycles/MB   instr/MB  br-miss/MB  llc-miss/MB\n";
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+      char line[160];
+      std::snprintf(line, sizeof line, "%-9s %7.3f", phase_names[p],
+                    static_cast<double>(times_[p]) / 1e6 / megabytes());
+      out << line;
+      for (int c = 0; c < COUNTER_COUNT; ++c) {
+        if (fds_[c] >= 0) {
+          std::snprintf(line, sizeof line, " %11.0f",
+                        static_cast<double>(totals_[p][c]) / megabytes());
+        } else {
+          std::snprintf(line, sizeof line, " %11s", "n/a");
+        }
+        out << line;
+      }
+      out << '\n';
+    }
+  }
+
+  void report_json(std::ostream &out) const {
+    static const char *const phase_names[PHASE_COUNT] = {"read", "automaton",
+                                                         "write"};
+    static const char *const counter_names[COUNTER_COUNT] = {
+        "cycles", "instructions", "branch_misses", "llc_misses"};
+    out << "{\"input_bytes\":" << input_bytes_
+        << ",\"skipped_bytes\":" << skipped_bytes_
+        << ",\"counters_available\":"
+        << (counters_available() ? "true" : "false") << ",\"phases\":{";
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+      out << (p ? "," : "") << '"' << phase_names[p] << "\":{\"time_ns\":"
+          << times_[p] << ",\"time_ns_per_mb\":"
+          << static_cast<double>(times_[p]) / megabytes();
+      for (int c = 0; c < COUNTER_COUNT; ++c) {
+        out << ",\"" << counter_names[c] << "\":";
+        if (fds_[c] >= 0) {
+          out << totals_[p][c];
+        } else {
+          out << "null";
+        }
+        out << ",\"" << counter_names[c] << "_per_mb\":";
+        if (fds_[c] >= 0) {
+          out << static_cast<double>(totals_[p][c]) / megabytes();
+        } else {
+          out << "null";
+        }
+      }
+      out << '}';
+    }
+    out << "}}\n";
+  }
+
+  int fds_[COUNTER_COUNT];
+  std::uint64_t last_[COUNTER_COUNT] = {};
+  std::uint64_t totals_[PHASE_COUNT][COUNTER_COUNT] = {};
+  std::uint64_t times_[PHASE_COUNT] = {};
+  std::chrono::steady_clock::time_point last_time_ =
+      std::chrono::steady_clock::now();
+  std::uint64_t input_bytes_ = 0;
+  std::uint64_t skipped_bytes_ = 0;
+  Phase current_ = AUTOMATON;
+  Phase saved_ = AUTOMATON;
+  int write_depth_ = 0;
+};
+
+// Источник, который относит время чтения к фазе READ и считает байты входа.
+// Без stats работает как обычный источник.
+template <class Source> class TimedInput {
+public:
+  TimedInput(Source &source, Stats *stats) : source_(source), stats_(stats) {}
+
+  std::size_t read(char *buf, std::size_t n) {
+    if (!stats_) {
+      return source_.read(buf, n);
+    }
+    stats_->enter(READ);
+    std::size_t got = source_.read(buf, n);
+    stats_->add_input(got);
+    stats_->enter(AUTOMATON);
+    return got;
+  }
+
+private:
+  Source &source_;
+  Stats *stats_;
+};
+
+} // namespace perf
@@ -0,0 +1,183 @@
+#pragma once
+
+// Конвейер из трех стадий для одного файла (--pipeline в Lab1/2.cpp и
+// Lab2): поток чтения, автомат в вызывающем потоке и поток записи. Стадии
+// обмениваются блоками по io::block_size через кольца spsc_ring.hpp:
+// заполненные блоки идут вперед, пустые возвращаются назад. Блоков в
+// обороте фиксированное число, поэтому медленная запись останавливает
+// автомат, а тот - чтение, и память не растет.
+//
+// Распаковка входа (io::GzipInput и др.) выполняется в потоке чтения, а
+// сжатие выхода - в потоке записи, поэтому на скорость автомата они не
+// влияют; новую стадию (например, хеш выхода) можно поставить так же -
+// оберткой над источником или выходом.
+//
+// Замеры --perf-stats в этом режиме относят все к фазе automaton: чтение
+// и запись идут в своих потоках. В трассе (--trace) у потоков свои
+// интервалы read и write, у автомата - automaton.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "io.hpp"
+#include "spsc_ring.hpp"
+#include "trace.hpp"
+
+namespace pipeline {
+
+// Блоков в обороте в каждом направлении.
+constexpr std::size_t depth = 8;
+
+using Block = std::string;
+using Ring = spsc::Ring<Block, depth>;
+
+// Приемник автомата: собирает выход в блоки и передает их потоку записи.
+class BlockSink {
+public:
+  BlockSink(Ring &full, Ring &empty) : full_(full), empty_(empty) {
+    current_.reserve(io::block_size);
+  }
+
+  void put(char c) {
+    current_.push_back(c);
+    if (current_.size() >= io::block_size) {
+      pass();
+    }
+  }
+
+  void write(const char *p, std::size_t n) {
+    current_.append(p, n);
+    if (current_.size() >= io::block_size) {
+      pass();
+    }
+  }
+
+  // Отдает неполный блок в конце работы.
+  void flush() {
+    if (!current_.empty()) {
+      pass();
+    }
+  }
+
+private:
+  void pass() {
+    full_.push(std::move(current_));
+    empty_.pop(current_);
+    current_.clear();
+  }
+
+  Ring &full_;
+  Ring &empty_;
+  Block current_;
+};
+
+// Source - любой объект с методом std::size_t read(char *, std::size_t).
+template <class Source> class Pipeline {
+public:
+  // Запускает потоки чтения и записи.
+  Pipeline(Source &in, io::Output &out) : sink_(out_full_, out_empty_) {
+    for (std::size_t i = 0; i < depth; ++i) {
+      Block block;
+      block.reserve(io::block_size);
+      in_empty_.push(std::move(block));
+      if (i + 1 < depth) {
+        // Еще один блок - у sink_.
+        out_empty_.push(Block());
+      }
+    }
+    reader_ = std::thread([this, &in]() { read(in); });
+    writer_ = std::thread([this, &out]() { write(out); });
+  }
+
+  Pipeline(const Pipeline &) = delete;
+  Pipeline &operator=(const Pipeline &) = delete;
+
+  ~Pipeline() { finish(); }
+
+  // Следующий блок входа (предыдущий возвращается потоку чтения); false в
+  // конце входа.
+  bool next(std::string_view &chunk) {
+    trace::Recorder *recorder = trace::current();
+    if (recorder && automaton_begin_) {
+      recorder->record("automaton", automaton_begin_, recorder->now());
+    }
+    if (!current_.empty()) {
+      in_empty_.push(std::move(current_));
+    }
+    if (!in_full_.pop(current_)) {
+      current_.clear();
+      return false;
+    }
+    chunk = current_;
+    automaton_begin_ = recorder ? recorder->now() : 0;
+    return true;
+  }
+
+  BlockSink &sink() { return sink_; }
+
+  // Дописывает выход и дожидается потоков. Выход после этого можно
+  // закрывать в вызывающем потоке.
+  void finish() {
+    if (!reader_.joinable()) {
+      return;
+    }
+    // Если вход дочитан не до конца, остаток пропускается.
+    std::string_view rest;
+    while (next(rest)) {
+    }
+    sink_.flush();
+    out_full_.close();
+    reader_.join();
+    writer_.join();
+  }
+
+  // Байт прочитано (после finish).
+  std::uint64_t input_bytes() const { return input_bytes_; }
+
+private:
+  void read(Source &in) {
+    Block block;
+    while (in_empty_.pop(block)) {
+      block.resize(io::block_size);
+      std::size_t n;
+      {
+        trace::Span span("read");
+        n = in.read(block.data(), block.size());
+      }
+      block.resize(n);
+      if (n == 0) {
+        break;
+      }
+      input_bytes_ += n;
+      in_full_.push(std::move(block));
+    }
+    in_full_.close();
+  }
+
+  void write(io::Output &out) {
+    Block block;
+    while (out_full_.pop(block)) {
+      out.write(block.data(), block.size());
+      block.clear();
+      out_empty_.push(std::move(block));
+    }
+    out.flush();
+  }
+
+  Ring in_full_;
+  Ring in_empty_;
+  Ring out_full_;
+  Ring out_empty_;
+  BlockSink sink_;
+  Block current_;
+  std::uint64_t input_bytes_ = 0; // пишет только поток чтения
+  std::uint64_t automaton_begin_ = 0;
+  std::thread reader_;
+  std::thread writer_;
+};
+
+} // namespace pipeline
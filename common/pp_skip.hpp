@@ -0,0 +1,230 @@
+#pragma once
+
+// Распознавание областей #if 0 для автоматов Lab1 и Lab2.
+// Директивой считается строка, где перед '#' стоят только пробелы и
+// табуляции. Внутри выключенной области ищутся только такие строки
+// (memchr по '#', как поиск конца комментария): #if/#ifdef/#ifndef
+// увеличивают вложенность, #endif уменьшает, а #else и #elif на внешнем
+// уровне завершают область. Комментарии внутри области не учитываются.
+//
+// Автоматы кормятся блоками, поэтому начало директивы может оказаться на
+// границе блоков: тогда оно откладывается, пока вид директивы не станет
+// ясен (не дольше head_limit символов).
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace pp {
+
+enum Directive {
+  INCOMPLETE, // текста пока мало, чтобы решить
+  IF_ZERO,    // #if 0
+  IF,         // #if, #ifdef, #ifndef
+  ELSE,
+  ELIF,
+  ENDIF,
+  OTHER
+};
+
+// Больше этого директива не откладывается.
+constexpr std::size_t head_limit = 64;
+
+inline bool is_blank(char c) { return c == ' ' || c == '\t'; }
+
+inline bool is_word(char c) {
+  return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9');
+}
+
+// Вид директивы; s начинается с '#'. В length - длина разобранного начала:
+// до конца ключевого слова, для IF_ZERO - до конца "0".
+inline Directive classify(std::string_view s, std::size_t *length) {
+  const bool more = s.size() < head_limit;
+  std::size_t i = 1;
+  while (i < s.size() && is_blank(s[i])) {
+    ++i;
+  }
+  std::size_t word = i;
+  while (i < s.size() && is_word(s[i])) {
+    ++i;
+  }
+  if (i == s.size()) {
+    return more ? INCOMPLETE : OTHER;
+  }
+  *length = i;
+  std::string_view keyword = s.substr(word, i - word);
+  if (keyword == "ifdef" || keyword == "ifndef") {
+    return IF;
+  }
+  if (keyword == "else") {
+    return ELSE;
+  }
+  if (keyword == "elif") {
+    return ELIF;
+  }
+  if (keyword == "endif") {
+    return ENDIF;
+  }
+  if (keyword != "if") {
+    return OTHER;
+  }
+
+  // #if 0, дальше только пробелы, конец строки или комментарий
+  while (i < s.size() && is_blank(s[i])) {
+    ++i;
+  }
+  if (i == s.size()) {
+    return more ? INCOMPLETE : IF;
+  }
+  if (s[i] != '0') {
+    return IF;
+  }
+  std::size_t zero = i + 1;
+  for (i = zero; i < s.size() && is_blank(s[i]); ++i) {
+  }
+  if (i == s.size()) {
+    return more ? INCOMPLETE : IF;
+  }
+  if (s[i] != '\n' && s[i] != '\r' && s[i] != '/') {
+    return IF;
+  }
+  *length = zero;
+  return IF_ZERO;
+}
+
+// Начинает ли '#' в hash директиву. begin - начало блока; blank_before -
+// из пробелов ли состоит часть строки до begin (см. blank_tail).
+inline bool directive_start(const char *begin, const char *hash,
+                            bool blank_before) {
+  const char *q = hash;
+  while (q != begin && is_blank(q[-1])) {
+    --q;
+  }
+  if (q == begin) {
+    return blank_before;
+  }
+  return q[-1] == '\n' || q[-1] == '\r';
+}
+
+// Состоит ли конец блока после последнего перевода строки из пробелов
+// (blank_before - то же для текста до блока).
+inline bool blank_tail(std::string_view chunk, bool blank_before) {
+  std::size_t i = chunk.size();
+  while (i > 0 && is_blank(chunk[i - 1])) {
+    --i;
+  }
+  if (i == 0) {
+    return blank_before;
+  }
+  return chunk[i - 1] == '\n' || chunk[i - 1] == '\r';
+}
+
+// Пропуск выключенной области.
+class Skipper {
+public:
+  // Чем закончилась область.
+  enum End { MORE, AT_ENDIF, AT_ELSE, AT_ELIF };
+
+  // Начало области сразу после "#if 0".
+  void start() {
+    depth_ = 1;
+    ending_ = MORE;
+    held_.clear();
+  }
+
+  // Ищет конец области в [p, end) блока, начатого в begin. Возвращает
+  // позицию, с которой продолжается обычный текст: перевод строки в конце
+  // #endif или #else, место после слова elif. Если область идет дальше
+  // блока - end и MORE.
+  const char *scan(const char *begin, const char *p, const char *end,
+                   bool blank_before, End &result) {
+    result = MORE;
+    if (!held_.empty()) {
+      std::string head = held_;
+      head.append(p, std::min<std::size_t>(end - p, head_limit));
+      std::size_t length = 0;
+      Directive d = classify(head, &length);
+      if (d == INCOMPLETE) {
+        held_ = head;
+        return end;
+      }
+      p += length > held_.size() ? length - held_.size() : 0;
+      held_.clear();
+      if (directive(d, result)) {
+        return p;
+      }
+    }
+
+    while (p != end) {
+      if (ending_ != MORE) {
+        // Остаток строки #endif или #else
+        auto nl = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (!nl) {
+          return end;
+        }
+        result = ending_;
+        ending_ = MORE;
+        return nl;
+      }
+      auto hash = static_cast<const char *>(std::memchr(p, '#', end - p));
+      if (!hash) {
+        return end;
+      }
+      p = hash + 1;
+      if (!directive_start(begin, hash, blank_before)) {
+        continue;
+      }
+      std::size_t length = 0;
+      Directive d = classify({hash, static_cast<std::size_t>(end - hash)},
+                             &length);
+      if (d == INCOMPLETE) {
+        held_.assign(hash, end);
+        return end;
+      }
+      p = hash + length;
+      if (directive(d, result)) {
+        return p;
+      }
+    }
+    return end;
+  }
+
+private:
+  // Учет вложенности; true, если область кончилась прямо здесь (#elif).
+  bool directive(Directive d, End &result) {
+    switch (d) {
+    case IF_ZERO:
+    case IF:
+      ++depth_;
+      break;
+    case ENDIF:
+      if (--depth_ == 0) {
+        ending_ = AT_ENDIF;
+      }
+      break;
+    case ELSE:
+      if (depth_ == 1) {
+        ending_ = AT_ELSE;
+      }
+      break;
+    case ELIF:
+      if (depth_ == 1) {
+        result = AT_ELIF;
+        return true;
+      }
+      break;
+    default:
+      break;
+    }
+    return false;
+  }
+
+  int depth_ = 0;
+  End ending_ = MORE;
+  std::string held_;
+};
+
+} // namespace pp
@@ -0,0 +1,152 @@
+#pragma once
+
+// Образец входа для выбора способа обработки (--engine=auto в Lab1/2.cpp
+// и Lab2). Первый блок входа читается заранее и разбирается упрощенным
+// автоматом C: доля байт в комментариях, доля байт в константах (строки,
+// символы, числа), есть ли байты вне ASCII. Вместе с размером файла и
+// тем, можно ли его отобразить в память, этого хватает, чтобы выбрать
+// путь, не разбирая весь файл. Прочитанный блок затем отдается автомату
+// первым (Prefixed), поэтому вход читается один раз.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "io.hpp"
+
+namespace sample {
+
+struct Profile {
+  std::uint64_t size = 0; // размер файла; 0 - неизвестен (поток)
+  bool mappable = false;  // обычный несжатый файл
+  bool compressed = false;
+  std::size_t sampled = 0; // байт в образце
+  double comments = 0;     // доля байт комментариев
+  double literals = 0;     // доля байт строк, символов и чисел
+  bool ascii = true;
+
+  // Весь вход уместился в образец.
+  bool complete() const { return size != 0 && sampled >= size; }
+
+  // Для журнала: "size 1048576, comments 12.5%, literals 3.0%, ascii".
+  std::string describe() const {
+    char line[128];
+    std::snprintf(line, sizeof line,
+                  "size %llu%s, comments %.1f%%, literals %.1f%%, %s",
+                  static_cast<unsigned long long>(size ? size : sampled),
+                  size ? "" : "+", comments * 100, literals * 100,
+                  ascii ? "ascii" : "non-ascii");
+    return line;
+  }
+};
+
+inline bool is_word(char c) {
+  return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9');
+}
+
+// Доли комментариев и констант в образце.
+inline void measure(std::string_view block, Profile &profile) {
+  enum { CODE, LINE, BLOCK, QUOTED } state = CODE;
+  char quote = 0;
+  std::size_t comment = 0;
+  std::size_t literal = 0;
+  bool ascii = true;
+  const std::size_t n = block.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    char c = block[i];
+    ascii = ascii && static_cast<unsigned char>(c) < 0x80;
+    switch (state) {
+    case CODE:
+      if (c == '/' && i + 1 < n && (block[i + 1] == '/' || block[i + 1] == '*')) {
+        state = block[i + 1] == '/' ? LINE : BLOCK;
+        comment += 2;
+        ++i;
+      } else if (c == '"' || c == '\'') {
+        state = QUOTED;
+        quote = c;
+        ++literal;
+      } else if (c >= '0' && c <= '9' && (i == 0 || !is_word(block[i - 1]))) {
+        // Число целиком, вместе с суффиксами
+        std::size_t j = i;
+        while (j < n && (is_word(block[j]) || block[j] == '.')) {
+          ++j;
+        }
+        literal += j - i;
+        i = j - 1;
+      }
+      break;
+    case LINE:
+      ++comment;
+      if (c == '\n') {
+        state = CODE;
+      }
+      break;
+    case BLOCK:
+      ++comment;
+      if (c == '*' && i + 1 < n && block[i + 1] == '/') {
+        ++comment;
+        ++i;
+        state = CODE;
+      }
+      break;
+    case QUOTED:
+      ++literal;
+      if (c == '\\' && i + 1 < n) {
+        ++literal;
+        ++i;
+      } else if (c == quote || c == '\n') {
+        state = CODE;
+      }
+      break;
+    }
+  }
+  profile.sampled = n;
+  profile.comments = n ? static_cast<double>(comment) / n : 0;
+  profile.literals = n ? static_cast<double>(literal) / n : 0;
+  profile.ascii = ascii;
+}
+
+// Чтение образца: первые io::block_size байт (меньше - только в конце
+// входа).
+template <class Source> std::string read_head(Source &in) {
+  std::string head(io::block_size, '\0');
+  std::size_t got = 0;
+  while (got < head.size()) {
+    std::size_t n = in.read(head.data() + got, head.size() - got);
+    if (n == 0) {
+      break;
+    }
+    got += n;
+  }
+  head.resize(got);
+  return head;
+}
+
+// Источник, который сначала отдает образец, а затем остаток source.
+template <class Source> class Prefixed {
+public:
+  Prefixed(std::string_view head, Source &source)
+      : head_(head), source_(source) {}
+
+  std::size_t read(char *buf, std::size_t n) {
+    if (pos_ < head_.size()) {
+      std::size_t k = std::min(n, head_.size() - pos_);
+      std::memcpy(buf, head_.data() + pos_, k);
+      pos_ += k;
+      return k;
+    }
+    return source_.read(buf, n);
+  }
+
+private:
+  std::string_view head_;
+  Source &source_;
+  std::size_t pos_ = 0;
+};
+
+} // namespace sample
@@ -0,0 +1,60 @@
+#pragma once
+
+// Векторные (SSE2) ядра поиска для автоматов. На платформах без SSE2
+// используется скалярный вариант с тем же результатом.
+
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace simd {
+
+inline bool is_digit_in_base(char c, int base) {
+  if (base == 8) {
+    return c >= '0' && c <= '7';
+  }
+  if (c >= '0' && c <= '9') {
+    return true;
+  }
+  if (base == 16) {
+    char lower = static_cast<char>(c | 0x20);
+    return lower >= 'a' && lower <= 'f';
+  }
+  return false;
+}
+
+// Возвращает указатель на первый символ, не являющийся цифрой системы
+// счисления base (8, 10 или 16), либо end.
+inline const char *digit_run(const char *p, const char *end, int base) {
+#if defined(__SSE2__)
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i max_digit = _mm_set1_epi8(base == 8 ? 7 : 9);
+  const __m128i lower_a = _mm_set1_epi8('a');
+  const __m128i five = _mm_set1_epi8(5);
+  const __m128i case_bit = _mm_set1_epi8(0x20);
+
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    // x - '0' <= 9 (беззнаково)  <=>  max(x - '0', 9) == 9
+    __m128i d = _mm_sub_epi8(v, zero);
+    __m128i ok = _mm_cmpeq_epi8(_mm_max_epu8(d, max_digit), max_digit);
+    if (base == 16) {
+      __m128i h = _mm_sub_epi8(_mm_or_si128(v, case_bit), lower_a);
+      ok = _mm_or_si128(ok, _mm_cmpeq_epi8(_mm_max_epu8(h, five), five));
+    }
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(ok)) ^ 0xFFFFu;
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+#endif
+  while (p != end && is_digit_in_base(*p, base)) {
+    ++p;
+  }
+  return p;
+}
+
+} // namespace simd
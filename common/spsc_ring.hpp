@@ -0,0 +1,111 @@
+#pragma once
+
+// Кольцо без блокировок для одного писателя и одного читателя.
+// Емкость фиксирована (степень двойки). Писатель двигает head_, читатель -
+// tail_; каждый держит у себя последнее увиденное значение чужого индекса
+// и перечитывает атомарную переменную, только когда по нему кольцо
+// выглядит полным или пустым. Индексы лежат в разных строках кэша.
+//
+// push и pop ждут, пока в кольце не появится место или элемент: это и есть
+// обратное давление между стадиями конвейера (pipeline.hpp). Ожидание
+// начинается с коротких повторов, затем уступает процессор, затем спит.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+
+namespace spsc {
+
+// Ожидание с нарастающей паузой.
+class Backoff {
+public:
+  void wait() {
+    if (step_ < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    } else if (step_ < 128) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    ++step_;
+  }
+
+private:
+  unsigned step_ = 0;
+};
+
+template <class T, std::size_t Capacity> class Ring {
+  static_assert(Capacity && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+public:
+  // Писатель: false, если кольцо полно.
+  bool try_push(T &value) {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_seen_ == Capacity) {
+      tail_seen_ = tail_.load(std::memory_order_acquire);
+      if (head - tail_seen_ == Capacity) {
+        return false;
+      }
+    }
+    slots_[head & (Capacity - 1)] = std::move(value);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Читатель: false, если кольцо пусто.
+  bool try_pop(T &value) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_seen_) {
+      head_seen_ = head_.load(std::memory_order_acquire);
+      if (tail == head_seen_) {
+        return false;
+      }
+    }
+    value = std::move(slots_[tail & (Capacity - 1)]);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Писатель: ждет места.
+  void push(T value) {
+    Backoff backoff;
+    while (!try_push(value)) {
+      backoff.wait();
+    }
+  }
+
+  // Читатель: ждет элемента; false, если писатель закрыл кольцо и
+  // элементов больше нет.
+  bool pop(T &value) {
+    Backoff backoff;
+    for (;;) {
+      if (try_pop(value)) {
+        return true;
+      }
+      if (closed_.load(std::memory_order_acquire)) {
+        // Все записи до close() уже видны.
+        return try_pop(value);
+      }
+      backoff.wait();
+    }
+  }
+
+  // Писатель: элементов больше не будет.
+  void close() { closed_.store(true, std::memory_order_release); }
+
+private:
+  alignas(64) std::atomic<std::size_t> head_{0};
+  std::size_t tail_seen_ = 0; // у писателя
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  std::size_t head_seen_ = 0; // у читателя
+  alignas(64) std::atomic<bool> closed_{false};
+  std::array<T, Capacity> slots_;
+};
+
+} // namespace spsc
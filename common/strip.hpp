@@ -0,0 +1,417 @@
+#pragma once
+
+// Общий автомат удаления комментариев для Lab0 и Lab1.
+// Возможности варианта (однострочные комментарии, учет строк, замена
+// комментария пробелом) задаются политикой на этапе компиляции, поэтому
+// для каждого варианта собирается свой цикл без проверок во время работы.
+// По отдельной политике автомат также вырезает области #if 0 (pp_skip.hpp)
+// и сжимает пробелы в коде (minify.hpp). Вырезанные комментарии можно
+// получить тем же проходом через приемник Comments (comments.hpp).
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "comments.hpp"
+#include "minify.hpp"
+#include "pp_skip.hpp"
+
+namespace strip {
+
+enum State {
+  NORMAL,
+  SLASH,
+  MULTI_COMMENT,
+  STAR_IN_MULTI_COMMENT,
+  SINGLE_COMMENT,
+  IN_STRING,
+  IN_CHAR,
+  SLASH_IN_STRING,
+  SLASH_IN_CHAR,
+  DIRECTIVE, // начало директивы на границе блоков
+  DISABLED   // внутри #if 0
+};
+
+template <bool LineComments, bool Strings, bool CommentToSpace,
+          bool SkipDisabled = false, bool Minify = false>
+struct Policy {
+  static constexpr bool line_comments = LineComments;
+  static constexpr bool strings = Strings;
+  static constexpr bool comment_to_space = CommentToSpace;
+  static constexpr bool skip_disabled = SkipDisabled;
+  static constexpr bool minify = Minify;
+};
+
+// Lab0: только /* */, строки и символы учитываются.
+using Lab0Policy = Policy<false, true, false>;
+// Lab1/1.cpp: только /* */.
+using BlockPolicy = Policy<false, false, false>;
+// Lab1/2.cpp: /* */ и //, строки и символы, комментарий заменяется пробелом.
+using FullPolicy = Policy<true, true, true>;
+// Lab1/2.cpp --skip-if0: то же и без областей #if 0.
+using FullSkipPolicy = Policy<true, true, true, true>;
+// Lab1/2.cpp --minify: вдобавок сжимаются пробелы.
+using FullMinifyPolicy = Policy<true, true, true, false, true>;
+using FullSkipMinifyPolicy = Policy<true, true, true, true, true>;
+
+// Приемник в памяти.
+struct StringSink {
+  std::string &out;
+
+  void put(char c) { out.push_back(c); }
+  void write(const char *p, std::size_t n) { out.append(p, n); }
+};
+
+// Приемник-поток (файл, std::cout и т.п.).
+struct StreamSink {
+  std::ostream &out;
+
+  void put(char c) { out.put(c); }
+  void write(const char *p, std::size_t n) {
+    out.write(p, static_cast<std::streamsize>(n));
+  }
+};
+
+// Автомат можно кормить частями: состояние сохраняется между вызовами feed.
+// Comments получает вырезанные комментарии (по умолчанию - никто).
+template <class P, class Comments = comments::None> class Stripper {
+public:
+  Stripper() = default;
+  explicit Stripper(Comments &comments) : comments_(&comments) {}
+
+  template <class Sink> void feed(std::string_view in, Sink &out) {
+    if constexpr (Comments::enabled) {
+      comments_->begin_chunk(in);
+      run(in, out);
+      comments_->end_chunk();
+    } else {
+      run(in, out);
+    }
+    if constexpr (P::skip_disabled) {
+      blank_tail_ = pp::blank_tail(in, blank_tail_);
+    }
+  }
+
+  // Конец входа: незавершенный '/' выводится как есть, отложенное начало
+  // директивы - тоже, если это не #if 0.
+  template <class Sink> void finish(Sink &out) {
+    if constexpr (Comments::enabled) {
+      // Незакрытый комментарий в конце входа тоже выдается.
+      if (state_ == MULTI_COMMENT || state_ == STAR_IN_MULTI_COMMENT ||
+          state_ == SINGLE_COMMENT) {
+        comments_->close();
+      }
+    }
+    if (state_ == SLASH) {
+      code("/", 1, out);
+    }
+    std::size_t length = 0;
+    if (state_ == DIRECTIVE && pp::classify(held_ + '\n', &length) != pp::IF_ZERO) {
+      code(held_.data(), held_.size(), out);
+    }
+    held_.clear();
+    state_ = NORMAL;
+    if constexpr (P::minify) {
+      minifier_.finish(out);
+    }
+  }
+
+  State state() const { return state_; }
+
+private:
+  template <class Sink> void run(std::string_view in, Sink &out) {
+    const char *p = in.data();
+    const char *end = p + in.size();
+
+    while (p != end) {
+      switch (state_) {
+      case NORMAL: {
+        const char *q = p;
+        while (q != end && !is_special(*q)) {
+          ++q;
+        }
+        if constexpr (P::skip_disabled) {
+          if (q != end && *q == '#') {
+            p = hash(in.data(), p, q, end, out);
+            break;
+          }
+        }
+        if (q == end || *q == '/') {
+          if (q != p) {
+            code(p, q - p, out);
+          }
+          if (q == end) {
+            return;
+          }
+          state_ = SLASH;
+        } else {
+          // Кавычка выводится вместе с участком перед ней.
+          code(p, q - p + 1, out);
+          state_ = *q == '"' ? IN_STRING : IN_CHAR;
+        }
+        p = q + 1;
+        break;
+      }
+
+      case SLASH:
+        if (*p == '*') {
+          ++p;
+          state_ = MULTI_COMMENT;
+          if constexpr (Comments::enabled) {
+            comments_->open(p, comments::Kind::BLOCK);
+          }
+        } else if (*p == '/') {
+          ++p;
+          if constexpr (P::line_comments) {
+            state_ = SINGLE_COMMENT;
+            if constexpr (Comments::enabled) {
+              comments_->open(p, comments::Kind::LINE);
+            }
+          } else {
+            put_slash(p, 2, in.data(), out);
+          }
+        } else {
+          // Это был не комментарий: символ разбирается заново в NORMAL.
+          put_slash(p, 1, in.data(), out);
+          state_ = NORMAL;
+        }
+        break;
+
+      case MULTI_COMMENT: {
+        auto q = static_cast<const char *>(std::memchr(p, '*', end - p));
+        if constexpr (Comments::enabled) {
+          comments_->text(p, q ? q + 1 - p : end - p);
+        }
+        if (!q) {
+          return;
+        }
+        p = q + 1;
+        state_ = STAR_IN_MULTI_COMMENT;
+        break;
+      }
+
+      case STAR_IN_MULTI_COMMENT: {
+        char c = *p++;
+        if constexpr (Comments::enabled) {
+          if (c == '/') {
+            comments_->close();
+          } else {
+            comments_->text(p - 1, 1);
+          }
+        }
+        if (c == '/') {
+          if constexpr (P::minify) {
+            minifier_.comment();
+          } else if constexpr (P::comment_to_space) {
+            out.put(' ');
+          }
+          state_ = NORMAL;
+        } else if (c != '*') {
+          state_ = MULTI_COMMENT;
+        }
+        break;
+      }
+
+      case SINGLE_COMMENT: {
+        const char *q = p;
+        while (p != end && *p != '\n' && *p != '\r') {
+          ++p;
+        }
+        if constexpr (Comments::enabled) {
+          comments_->text(q, p - q);
+          if (p != end) {
+            comments_->close();
+          }
+        }
+        if (p == end) {
+          return;
+        }
+        code(p++, 1, out);
+        state_ = NORMAL;
+        break;
+      }
+
+      case IN_STRING:
+        p = quoted(p, end, '"', SLASH_IN_STRING, out);
+        break;
+
+      case IN_CHAR:
+        p = quoted(p, end, '\'', SLASH_IN_CHAR, out);
+        break;
+
+      case SLASH_IN_STRING:
+        text(p++, 1, out);
+        state_ = IN_STRING;
+        break;
+
+      case SLASH_IN_CHAR:
+        text(p++, 1, out);
+        state_ = IN_CHAR;
+        break;
+
+      case DIRECTIVE:
+        p = held_directive(p, end, out);
+        break;
+
+      case DISABLED: {
+        pp::Skipper::End result;
+        p = skipper_.scan(in.data(), p, end, blank_tail_, result);
+        if (result == pp::Skipper::AT_ELSE) {
+          // Дальше идет включенная ветка до парного #endif.
+          code("#if 1", 5, out);
+        } else if (result == pp::Skipper::AT_ELIF) {
+          // Условие #elif становится условием #if.
+          code("#if", 3, out);
+        }
+        if (result != pp::Skipper::MORE) {
+          state_ = NORMAL;
+        }
+        break;
+      }
+      }
+    }
+  }
+
+  static bool is_special(char c) {
+    if constexpr (P::strings && P::skip_disabled) {
+      return c == '/' || c == '"' || c == '\'' || c == '#';
+    } else if constexpr (P::strings) {
+      return c == '/' || c == '"' || c == '\'';
+    } else {
+      return c == '/';
+    }
+  }
+
+  // '#' в q. Если это #if 0 в начале строки, область от '#' до конца строки
+  // с парным #endif вырезается; иначе '#' выводится как обычный символ.
+  template <class Sink>
+  const char *hash(const char *begin, const char *p, const char *q,
+                   const char *end, Sink &out) {
+    if (!pp::directive_start(begin, q, blank_tail_)) {
+      code(p, q - p + 1, out);
+      return q + 1;
+    }
+    std::size_t length = 0;
+    pp::Directive d =
+        pp::classify({q, static_cast<std::size_t>(end - q)}, &length);
+    if (d == pp::INCOMPLETE) {
+      code(p, q - p, out);
+      held_.assign(q, end);
+      state_ = DIRECTIVE;
+      return end;
+    }
+    if (d == pp::IF_ZERO) {
+      if (q != p) {
+        code(p, q - p, out);
+      }
+      skipper_.start();
+      state_ = DISABLED;
+      return q + length;
+    }
+    code(p, q - p + 1, out);
+    return q + 1;
+  }
+
+  // Продолжение директивы, начатой в прошлом блоке.
+  template <class Sink>
+  const char *held_directive(const char *p, const char *end, Sink &out) {
+    std::string head = held_;
+    head.append(p, std::min<std::size_t>(end - p, pp::head_limit));
+    std::size_t length = 0;
+    pp::Directive d = pp::classify(head, &length);
+    if (d == pp::INCOMPLETE) {
+      held_ = head;
+      return end;
+    }
+    state_ = NORMAL;
+    if (d == pp::IF_ZERO) {
+      skipper_.start();
+      state_ = DISABLED;
+      p += length > held_.size() ? length - held_.size() : 0;
+    } else {
+      // Отложенное начало состоит из '#', пробелов и букв - выводится как
+      // есть, дальше разбор идет обычным путем.
+      code(held_.data(), held_.size(), out);
+    }
+    held_.clear();
+    return p;
+  }
+
+  // Отложенный '/' (за back символов до p) выводится прямо из входа, если
+  // он в этом же куске: приемник, следящий за указателями (io::SpanSink),
+  // видит тогда непрерывный участок входа.
+  template <class Sink>
+  void put_slash(const char *p, std::ptrdiff_t back, const char *begin,
+                 Sink &out) {
+    code(p - begin >= back ? p - back : "/", 1, out);
+  }
+
+  // Вывод кода вне строк и символов.
+  template <class Sink> void code(const char *p, std::size_t n, Sink &out) {
+    if constexpr (P::minify) {
+      minifier_.code(p, n, out);
+    } else {
+      out.write(p, n);
+    }
+  }
+
+  // Вывод содержимого строки или символа.
+  template <class Sink> void text(const char *p, std::size_t n, Sink &out) {
+    if constexpr (P::minify) {
+      minifier_.text(p, n, out);
+    } else {
+      out.write(p, n);
+    }
+  }
+
+  template <class Sink>
+  const char *quoted(const char *p, const char *end, char quote,
+                     State escape, Sink &out) {
+    const char *q = p;
+    while (q != end && *q != quote && *q != '\\') {
+      ++q;
+    }
+    if (q == end) {
+      text(p, q - p, out);
+      return q;
+    }
+    text(p, q - p + 1, out);
+    state_ = *q == '\\' ? escape : NORMAL;
+    return q + 1;
+  }
+
+  State state_ = NORMAL;
+  // Для областей #if 0
+  pp::Skipper skipper_;
+  std::string held_;
+  bool blank_tail_ = true; // начало входа - начало строки
+  // Для сжатия пробелов
+  minify::Minifier minifier_;
+  Comments *comments_ = nullptr;
+};
+
+// Обработка целого буфера в памяти.
+template <class P, class Sink>
+void strip(std::string_view in, Sink &out, P = {}) {
+  Stripper<P> stripper;
+  stripper.feed(in, out);
+  stripper.finish(out);
+}
+
+// Обработка источника блоками фиксированного размера. Source - любой
+// объект с методом std::size_t read(char *, std::size_t), например io::Input.
+template <class P, class Source, class Sink>
+void strip_stream(Source &in, Sink &out, P = {}) {
+  Stripper<P> stripper;
+  std::vector<char> buf(1 << 16);
+  while (std::size_t n = in.read(buf.data(), buf.size())) {
+    stripper.feed({buf.data(), n}, out);
+  }
+  stripper.finish(out);
+}
+
+} // namespace strip
@@ -0,0 +1,371 @@
+#pragma once
+
+// Потоковое чтение и запись архивов tar (режим --tar в Lab1/2.cpp и
+// Lab2) без распаковки на диск. Reader разбирает заголовки по мере чтения
+// источника (обычно io::Input, поэтому .tar.gz и .tar.zst читаются
+// прозрачно) и отдает данные текущего члена через read(), как обычный
+// источник для автомата. Writer пишет члены в io::Output.
+//
+// Поддерживаются заголовки ustar и GNU, размеры в восьмеричной записи и
+// в base-256. Расширенные заголовки (pax 'x' и 'g', GNU 'L' и 'K')
+// разбираются ради полного имени члена и проходят в выход без изменений;
+// только запись size в pax-заголовке члена убирается, если размер члена
+// в выходе другой (он тогда пишется в основной заголовок).
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "io.hpp"
+
+namespace tar {
+
+constexpr std::size_t block = 512;
+
+// Расширенный заголовок длиннее этого считается ошибкой архива.
+constexpr std::uint64_t max_extended = 1 << 20;
+
+// Размер члена с выравниванием должен помещаться в 64 бита.
+constexpr std::uint64_t max_size = ~std::uint64_t(0) - block;
+
+inline std::uint64_t padded(std::uint64_t size) {
+  return (size + block - 1) / block * block;
+}
+
+// Число из поля заголовка: восьмеричное (до NUL или пробела) или
+// base-256 (старший бит первого байта).
+inline bool parse_number(const char *field, std::size_t n,
+                         std::uint64_t &value) {
+  value = 0;
+  if (static_cast<unsigned char>(field[0]) & 0x80) {
+    for (std::size_t i = 1; i < n; ++i) {
+      if (value >> 56) {
+        return false;
+      }
+      value = value << 8 | static_cast<unsigned char>(field[i]);
+    }
+    return true;
+  }
+  std::size_t i = 0;
+  while (i < n && field[i] == ' ') {
+    ++i;
+  }
+  for (; i < n && field[i] != '\0' && field[i] != ' '; ++i) {
+    if (field[i] < '0' || field[i] > '7') {
+      return false;
+    }
+    value = value << 3 | static_cast<std::uint64_t>(field[i] - '0');
+  }
+  return true;
+}
+
+// Размер в поле size (12 байт): восьмеричный, если помещается, иначе
+// base-256.
+inline void put_size(char *header, std::uint64_t size) {
+  char *field = header + 124;
+  if (size < (std::uint64_t(1) << 33)) {
+    for (int i = 10; i >= 0; --i) {
+      field[i] = static_cast<char>('0' + (size & 7));
+      size >>= 3;
+    }
+    field[11] = '\0';
+    return;
+  }
+  field[0] = static_cast<char>(0x80);
+  for (int i = 11; i >= 1; --i) {
+    field[i] = static_cast<char>(size & 0xFF);
+    size >>= 8;
+  }
+}
+
+// Сумма байт заголовка, в которой поле контрольной суммы - пробелы.
+inline unsigned checksum(const char *header) {
+  unsigned sum = 0;
+  for (std::size_t i = 0; i < block; ++i) {
+    sum += i >= 148 && i < 156 ? ' ' : static_cast<unsigned char>(header[i]);
+  }
+  return sum;
+}
+
+inline void put_checksum(char *header) {
+  unsigned sum = checksum(header);
+  for (int i = 5; i >= 0; --i) {
+    header[148 + i] = static_cast<char>('0' + (sum & 7));
+    sum >>= 3;
+  }
+  header[154] = '\0';
+  header[155] = ' ';
+}
+
+// Поле до первого NUL, не длиннее n.
+inline std::string_view field(const char *p, std::size_t n) {
+  return {p, static_cast<std::size_t>(std::find(p, p + n, '\0') - p)};
+}
+
+// Обход записей pax "длина ключ=значение\n"; f(запись, ключ, значение).
+// false, если данные испорчены.
+template <class F> bool for_each_record(std::string_view data, F f) {
+  while (!data.empty()) {
+    std::size_t space = data.find(' ');
+    std::uint64_t length = 0;
+    for (std::size_t i = 0; i < space && i < data.size(); ++i) {
+      if (data[i] < '0' || data[i] > '9') {
+        return false;
+      }
+      length = length * 10 + static_cast<std::uint64_t>(data[i] - '0');
+    }
+    if (space == data.npos || length <= space + 1 || length > data.size()) {
+      return false;
+    }
+    std::string_view record = data.substr(0, length);
+    std::size_t equals = record.find('=');
+    if (equals == record.npos || record.back() != '\n') {
+      return false;
+    }
+    f(record, record.substr(space + 1, equals - space - 1),
+      record.substr(equals + 1, length - equals - 2));
+    data.remove_prefix(length);
+  }
+  return true;
+}
+
+struct Member {
+  std::string name;  // полное: из pax path, GNU longname или prefix/name
+  char type = '0';   // typeflag
+  std::uint64_t size = 0; // байт данных в архиве
+  char header[block];     // основной заголовок как в архиве
+  // Расширенные заголовки перед ним: заголовок и данные с выравниванием.
+  std::vector<std::string> extended;
+
+  bool regular() const { return type == '0' || type == '\0' || type == '7'; }
+};
+
+// Source - любой объект с методом std::size_t read(char *, std::size_t).
+template <class Source> class Reader {
+public:
+  explicit Reader(Source &in) : in_(in) {}
+
+  // Следующий член (остаток данных прошлого пропускается); false в конце
+  // архива или при ошибке (тогда error() не пуст).
+  bool next(Member &member) {
+    if (!skip(remaining_ + padding_)) {
+      return false;
+    }
+    remaining_ = padding_ = 0;
+    member.extended.clear();
+    std::string long_name;
+    std::string pax_path;
+    std::uint64_t pax_size = 0;
+    bool has_pax_size = false;
+    for (;;) {
+      char *header = member.header;
+      if (!read_full(header, block)) {
+        return fail("unexpected end of archive");
+      }
+      if (std::all_of(header, header + block,
+                      [](char c) { return c == '\0'; })) {
+        return false;
+      }
+      std::uint64_t stored = 0;
+      if (!parse_number(header + 148, 8, stored) ||
+          stored != checksum(header)) {
+        return fail("bad tar header checksum");
+      }
+      std::uint64_t size = 0;
+      if (!parse_number(header + 124, 12, size) || size > max_size) {
+        return fail("bad tar header size");
+      }
+      char type = header[156];
+      if (type == 'L' || type == 'K' || type == 'x' || type == 'g') {
+        if (size > max_extended) {
+          return fail("extended tar header is too long");
+        }
+        std::string entry(header, block);
+        entry.resize(block + padded(size));
+        if (!read_full(entry.data() + block, entry.size() - block)) {
+          return fail("unexpected end of archive");
+        }
+        std::string_view data(entry.data() + block, size);
+        if (type == 'L') {
+          long_name = field(data.data(), data.size());
+        } else if (type == 'x' &&
+                   !for_each_record(data, [&](std::string_view,
+                                              std::string_view key,
+                                              std::string_view value) {
+                     if (key == "path") {
+                       pax_path = value;
+                     } else if (key == "size") {
+                       has_pax_size = parse_decimal(value, pax_size);
+                     }
+                   })) {
+          return fail("bad pax header");
+        }
+        member.extended.push_back(std::move(entry));
+        continue;
+      }
+
+      member.type = type;
+      // У ссылок, устройств, каталогов и каналов данных нет.
+      bool has_data = std::strchr("123456", type) == nullptr || type == '\0';
+      member.size = !has_data ? 0 : has_pax_size ? pax_size : size;
+      if (!pax_path.empty()) {
+        member.name = pax_path;
+      } else if (!long_name.empty()) {
+        member.name = long_name;
+      } else {
+        std::string_view prefix = field(header + 345, 155);
+        // У старого формата GNU (магия "ustar ") на месте prefix - время.
+        std::string_view magic(header + 257, 6);
+        member.name.clear();
+        if (magic == std::string_view("ustar\0", 6) && !prefix.empty()) {
+          member.name.append(prefix).push_back('/');
+        }
+        member.name.append(field(header, 100));
+      }
+      remaining_ = member.size;
+      padding_ = padded(member.size) - member.size;
+      return true;
+    }
+  }
+
+  // Данные текущего члена.
+  std::size_t read(char *buf, std::size_t n) {
+    n = static_cast<std::size_t>(std::min<std::uint64_t>(n, remaining_));
+    if (n == 0) {
+      return 0;
+    }
+    std::size_t got = in_.read(buf, n);
+    if (got == 0) {
+      fail("unexpected end of archive");
+      remaining_ = padding_ = 0;
+      return 0;
+    }
+    remaining_ -= got;
+    return got;
+  }
+
+  const std::string &error() const { return error_; }
+
+private:
+  static bool parse_decimal(std::string_view text, std::uint64_t &value) {
+    value = 0;
+    for (char c : text) {
+      if (c < '0' || c > '9' || value > max_size / 10) {
+        return false;
+      }
+      value = value * 10 + static_cast<std::uint64_t>(c - '0');
+    }
+    return !text.empty() && value <= max_size;
+  }
+
+  bool fail(const char *message) {
+    if (error_.empty()) {
+      error_ = message;
+    }
+    return false;
+  }
+
+  bool read_full(char *buf, std::size_t n) {
+    while (n > 0) {
+      std::size_t got = in_.read(buf, n);
+      if (got == 0) {
+        return false;
+      }
+      buf += got;
+      n -= got;
+    }
+    return true;
+  }
+
+  bool skip(std::uint64_t n) {
+    char buf[4096];
+    while (n > 0) {
+      auto k = static_cast<std::size_t>(std::min<std::uint64_t>(n, sizeof buf));
+      if (!read_full(buf, k)) {
+        return fail("unexpected end of archive");
+      }
+      n -= k;
+    }
+    return true;
+  }
+
+  Source &in_;
+  std::uint64_t remaining_ = 0; // байт данных текущего члена
+  std::uint64_t padding_ = 0;   // выравнивание после них
+  std::string error_;
+};
+
+class Writer {
+public:
+  explicit Writer(io::Output &out) : out_(out) {}
+
+  // Заголовки члена m с size байт данных (размер в выходе может
+  // отличаться от размера в архиве).
+  void begin(const Member &m, std::uint64_t size) {
+    bool resized = size != m.size;
+    for (const std::string &entry : m.extended) {
+      if (resized && entry[156] == 'x') {
+        write_pax_without_size(entry);
+      } else {
+        out_.write(entry.data(), entry.size());
+      }
+    }
+    if (resized) {
+      char header[block];
+      std::memcpy(header, m.header, block);
+      put_size(header, size);
+      put_checksum(header);
+      out_.write(header, block);
+    } else {
+      out_.write(m.header, block);
+    }
+    written_ = 0;
+  }
+
+  void write(const char *p, std::size_t n) {
+    out_.write(p, n);
+    written_ += n;
+  }
+
+  // Выравнивание данных члена до блока.
+  void end() {
+    static const char zeros[block] = {};
+    out_.write(zeros, padded(written_) - written_);
+  }
+
+  // Конец архива: два нулевых блока.
+  void finish() {
+    static const char zeros[2 * block] = {};
+    out_.write(zeros, sizeof zeros);
+  }
+
+private:
+  void write_pax_without_size(const std::string &entry) {
+    std::uint64_t size = 0;
+    parse_number(entry.data() + 124, 12, size);
+    std::string data;
+    for_each_record(std::string_view(entry).substr(block, size),
+                    [&](std::string_view record, std::string_view key,
+                        std::string_view) {
+                      if (key != "size") {
+                        data.append(record);
+                      }
+                    });
+    char header[block];
+    std::memcpy(header, entry.data(), block);
+    put_size(header, data.size());
+    put_checksum(header);
+    out_.write(header, block);
+    data.resize(padded(data.size()));
+    out_.write(data.data(), data.size());
+  }
+
+  io::Output &out_;
+  std::uint64_t written_ = 0;
+};
+
+} // namespace tar
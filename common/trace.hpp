@@ -0,0 +1,238 @@
+#pragma once
+
+// Трасса работы в формате Chrome trace events (--trace FILE): открывается в
+// chrome://tracing или ui.perfetto.dev. Для каждого потока записываются
+// интервалы: файл целиком и внутри него фазы open, read, automaton, write.
+//
+// События копятся в буфере своего потока без блокировок (мьютекс берется
+// только при первом событии потока) и выводятся одним файлом в конце
+// работы, когда рабочие потоки уже завершены. Пока трасса не включена,
+// каждая точка записи стоит одну проверку указателя.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "io.hpp"
+
+namespace trace {
+
+class Recorder;
+
+// Включенная трасса или nullptr.
+inline Recorder *&current() {
+  static Recorder *recorder = nullptr;
+  return recorder;
+}
+
+class Recorder {
+public:
+  Recorder() { current() = this; }
+  ~Recorder() { current() = nullptr; }
+
+  Recorder(const Recorder &) = delete;
+  Recorder &operator=(const Recorder &) = delete;
+
+  // Наносекунды от начала трассы.
+  std::uint64_t now() const {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_)
+            .count());
+  }
+
+  // Интервал [begin, end) в текущем потоке; file - необязательное имя файла.
+  void record(const char *name, std::uint64_t begin, std::uint64_t end,
+              std::string_view file = {}) {
+    Buffer &buf = buffer();
+    int arg = -1;
+    if (!file.empty()) {
+      arg = static_cast<int>(buf.files.size());
+      buf.files.emplace_back(file);
+    }
+    buf.events.push_back({name, begin, end - begin, arg});
+  }
+
+  // Запись трассы; вызывается после завершения рабочих потоков.
+  bool write(const std::string &path, std::string *error) {
+    auto out = io::open_output(path, error);
+    if (!out) {
+      return false;
+    }
+    char line[256];
+    auto text = [&](const char *s) { out->write(s, std::strlen(s)); };
+    bool first = true;
+    auto separator = [&]() {
+      text(first ? "\n" : ",\n");
+      first = false;
+    };
+    text("{\"traceEvents\":[");
+    for (const auto &buf : buffers_) {
+      separator();
+      int n = std::snprintf(line, sizeof line,
+                            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                            "\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                            buf->tid, buf->tid);
+      out->write(line, static_cast<std::size_t>(n));
+      for (const Event &e : buf->events) {
+        separator();
+        n = std::snprintf(line, sizeof line,
+                          "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                          "\"ts\":%.3f,\"dur\":%.3f",
+                          e.name, buf->tid, static_cast<double>(e.begin) / 1e3,
+                          static_cast<double>(e.duration) / 1e3);
+        out->write(line, static_cast<std::size_t>(n));
+        if (e.file >= 0) {
+          text(",\"args\":{\"file\":\"");
+          write_escaped(*out, buf->files[static_cast<std::size_t>(e.file)]);
+          text("\"}");
+        }
+        out->put('}');
+      }
+    }
+    text("\n],\"displayTimeUnit\":\"ms\"}\n");
+    if (!out->close()) {
+      *error = out->error();
+      return false;
+    }
+    return true;
+  }
+
+private:
+  struct Event {
+    const char *name;
+    std::uint64_t begin;
+    std::uint64_t duration;
+    int file; // индекс в Buffer::files или -1
+  };
+
+  struct Buffer {
+    int tid;
+    std::vector<Event> events;
+    std::vector<std::string> files;
+  };
+
+  Buffer &buffer() {
+    thread_local Recorder *owner = nullptr;
+    thread_local Buffer *buf = nullptr;
+    if (owner != this) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      buffers_.push_back(std::make_unique<Buffer>());
+      buf = buffers_.back().get();
+      buf->tid = static_cast<int>(buffers_.size());
+      owner = this;
+    }
+    return *buf;
+  }
+
+  static void write_escaped(io::Output &out, std::string_view s) {
+    for (char c : s) {
+      if (c == '"' || c == '\\') {
+        out.put('\\');
+        out.put(c);
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char esc[8];
+        std::snprintf(esc, sizeof esc, "\\u%04x", c);
+        out.write(esc, 6);
+      } else {
+        out.put(c);
+      }
+    }
+  }
+
+  std::chrono::steady_clock::time_point start_ =
+      std::chrono::steady_clock::now();
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+};
+
+// Интервал на время жизни объекта. Имя фазы - строковый литерал; file
+// должен жить до конца интервала.
+class Span {
+public:
+  explicit Span(const char *name, std::string_view file = {})
+      : recorder_(current()), name_(name), file_(file) {
+    if (recorder_) {
+      begin_ = recorder_->now();
+    }
+  }
+  ~Span() {
+    if (recorder_) {
+      recorder_->record(name_, begin_, recorder_->now(), file_);
+    }
+  }
+
+  Span(const Span &) = delete;
+  Span &operator=(const Span &) = delete;
+
+private:
+  Recorder *recorder_;
+  const char *name_;
+  std::string_view file_;
+  std::uint64_t begin_ = 0;
+};
+
+// Источник, который отмечает каждое чтение как read, а время между
+// чтениями (разбор прочитанного блока) - как automaton.
+template <class Source> class TracedInput {
+public:
+  explicit TracedInput(Source &source) : source_(source) {}
+
+  std::size_t read(char *buf, std::size_t n) {
+    Recorder *recorder = current();
+    if (!recorder) {
+      return source_.read(buf, n);
+    }
+    std::uint64_t begin = recorder->now();
+    if (automaton_begin_) {
+      recorder->record("automaton", automaton_begin_, begin);
+    }
+    std::size_t got = source_.read(buf, n);
+    std::uint64_t end = recorder->now();
+    recorder->record("read", begin, end);
+    automaton_begin_ = got ? end : 0;
+    return got;
+  }
+
+private:
+  Source &source_;
+  std::uint64_t automaton_begin_ = 0;
+};
+
+// Наблюдатель за выходом: каждая запись - интервал write. Передает
+// события дальше (например, в perf::Stats).
+class WriteSpans : public io::WriteObserver {
+public:
+  explicit WriteSpans(io::WriteObserver *next) : next_(next) {}
+
+  void before_write() override {
+    if (depth_++ == 0 && current()) {
+      begin_ = current()->now();
+    }
+    if (next_) {
+      next_->before_write();
+    }
+  }
+
+  void after_write() override {
+    if (next_) {
+      next_->after_write();
+    }
+    if (--depth_ == 0 && current()) {
+      current()->record("write", begin_, current()->now());
+    }
+  }
+
+private:
+  io::WriteObserver *next_;
+  int depth_ = 0;
+  std::uint64_t begin_ = 0;
+};
+
+} // namespace trace
@@ -0,0 +1,240 @@
+#pragma once
+
+// Наблюдение за деревом исходников через inotify (только Linux).
+// Наблюдатели ставятся на все каталоги один раз; wait() возвращает набор
+// измененных и удаленных файлов после того, как дерево затихло на время
+// debounce, поэтому серия быстрых записей в один файл дает одно изменение.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace watch {
+
+enum class ChangeKind { MODIFIED, REMOVED };
+
+// Путь относительно корня; REMOVED может относиться и к каталогу -
+// тогда удалено все, что лежало под ним.
+struct Change {
+  std::string path;
+  ChangeKind kind;
+};
+
+// Все обычные файлы под каталогом root (пути относительно root).
+inline std::vector<std::string> list_files(const std::string &root,
+                                           const std::string &subdir = "") {
+  namespace fs = std::filesystem;
+  std::vector<std::string> files;
+  std::error_code ec;
+  fs::path base = subdir.empty() ? fs::path(root) : fs::path(root) / subdir;
+  for (fs::recursive_directory_iterator it(base, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    if (it->is_regular_file(ec)) {
+      files.push_back(fs::relative(it->path(), root, ec).generic_string());
+    }
+  }
+  return files;
+}
+
+// true, если path лежит внутри root (или совпадает с ним). Выход внутри
+// наблюдаемого дерева вызывал бы бесконечные обновления.
+inline bool inside(const std::string &root, const std::string &path) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  fs::path a = fs::weakly_canonical(root, ec);
+  fs::path b = fs::weakly_canonical(path, ec);
+  return std::mismatch(a.begin(), a.end(), b.begin(), b.end()).first ==
+         a.end();
+}
+
+class TreeWatcher {
+public:
+  explicit TreeWatcher(const std::string &root)
+      : root_(root), fd_(inotify_init1(IN_CLOEXEC | IN_NONBLOCK)) {
+    if (fd_ < 0) {
+      error_ = std::strerror(errno);
+      return;
+    }
+    add_tree("");
+    for (std::string &file : list_files(root_)) {
+      files_.insert(std::move(file));
+    }
+  }
+
+  ~TreeWatcher() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  TreeWatcher(const TreeWatcher &) = delete;
+  TreeWatcher &operator=(const TreeWatcher &) = delete;
+
+  bool ok() const { return fd_ >= 0 && error_.empty(); }
+  const std::string &error() const { return error_; }
+
+  // Ждет первого события, затем собирает события, пока их нет в течение
+  // debounce. Изменения по одному пути сливаются (побеждает последнее).
+  std::vector<Change> wait(std::chrono::milliseconds debounce) {
+    std::map<std::string, ChangeKind> pending;
+    int timeout = -1;
+    for (;;) {
+      pollfd pfd{fd_, POLLIN, 0};
+      int rc = ::poll(&pfd, 1, timeout);
+      if (rc < 0 && errno != EINTR) {
+        error_ = std::strerror(errno);
+        break;
+      }
+      if (rc == 0) {
+        break;
+      }
+      drain(pending);
+      if (!pending.empty()) {
+        timeout = static_cast<int>(debounce.count());
+      }
+    }
+
+    std::vector<Change> changes;
+    for (auto &[path, kind] : pending) {
+      if (kind == ChangeKind::MODIFIED) {
+        files_.insert(path);
+      } else {
+        forget(path);
+      }
+      changes.push_back({path, kind});
+    }
+    return changes;
+  }
+
+private:
+  static constexpr std::uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO |
+                                        IN_MOVED_FROM | IN_CREATE | IN_DELETE |
+                                        IN_DELETE_SELF;
+
+  static std::string join(const std::string &dir, const char *name) {
+    return dir.empty() ? std::string(name) : dir + '/' + name;
+  }
+
+  // Ставит наблюдателей на каталог rel и все вложенные каталоги.
+  void add_tree(const std::string &rel) {
+    namespace fs = std::filesystem;
+    fs::path base = rel.empty() ? fs::path(root_) : fs::path(root_) / rel;
+    add_dir(rel);
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(base, ec), end; !ec && it != end;
+         it.increment(ec)) {
+      if (it->is_directory(ec)) {
+        add_dir(fs::relative(it->path(), root_, ec).generic_string());
+      }
+    }
+  }
+
+  void add_dir(const std::string &rel) {
+    std::string full = rel.empty() ? root_ : root_ + '/' + rel;
+    int wd = inotify_add_watch(fd_, full.c_str(), mask);
+    if (wd < 0) {
+      if (rel.empty()) {
+        error_ = std::strerror(errno);
+      }
+      return;
+    }
+    dirs_[wd] = rel;
+  }
+
+  void drain(std::map<std::string, ChangeKind> &pending) {
+    alignas(inotify_event) char buf[64 * 1024];
+    for (;;) {
+      ssize_t n = ::read(fd_, buf, sizeof buf);
+      if (n <= 0) {
+        return;
+      }
+      for (char *p = buf; p < buf + n;) {
+        auto *event = reinterpret_cast<inotify_event *>(p);
+        handle(*event, pending);
+        p += sizeof(inotify_event) + event->len;
+      }
+    }
+  }
+
+  // Убирает из известных файл path или все файлы под каталогом path.
+  void forget(const std::string &path) {
+    files_.erase(path);
+    std::string prefix = path + '/';
+    auto it = files_.lower_bound(prefix);
+    while (it != files_.end() && it->compare(0, prefix.size(), prefix) == 0) {
+      it = files_.erase(it);
+    }
+  }
+
+  // События потеряны: дерево сканируется заново. Все его файлы считаются
+  // измененными, а известные раньше (или появившиеся в этой серии) и
+  // пропавшие - удаленными.
+  void rescan(std::map<std::string, ChangeKind> &pending) {
+    add_tree("");
+    std::vector<std::string> listed = list_files(root_);
+    std::set<std::string> current(listed.begin(), listed.end());
+    for (const std::string &file : files_) {
+      if (!current.count(file)) {
+        pending[file] = ChangeKind::REMOVED;
+      }
+    }
+    for (auto &[path, kind] : pending) {
+      if (kind == ChangeKind::MODIFIED && !current.count(path)) {
+        kind = ChangeKind::REMOVED;
+      }
+    }
+    for (const std::string &file : current) {
+      pending[file] = ChangeKind::MODIFIED;
+    }
+  }
+
+  void handle(const inotify_event &event,
+              std::map<std::string, ChangeKind> &pending) {
+    if (event.mask & IN_Q_OVERFLOW) {
+      rescan(pending);
+      return;
+    }
+    if (event.mask & IN_IGNORED) {
+      dirs_.erase(event.wd);
+      return;
+    }
+    auto dir = dirs_.find(event.wd);
+    if (dir == dirs_.end() || event.len == 0) {
+      return;
+    }
+    std::string path = join(dir->second, event.name);
+
+    if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+      pending[path] = ChangeKind::REMOVED;
+    } else if (event.mask & IN_ISDIR) {
+      if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+        // Файлы могли появиться раньше, чем наблюдатель на каталог.
+        add_tree(path);
+        for (std::string &file : list_files(root_, path)) {
+          pending[file] = ChangeKind::MODIFIED;
+        }
+      }
+    } else if (event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+      pending[path] = ChangeKind::MODIFIED;
+    }
+  }
+
+  std::string root_;
+  int fd_;
+  std::string error_;
+  std::unordered_map<int, std::string> dirs_;
+  std::set<std::string> files_; // файлы дерева по последнему wait()
+};
+
+} // namespace watch
@@ -0,0 +1,95 @@
+// Регрессионные проверки выдачи комментариев (comments::Writer).
+// Сборка и запуск из корня репозитория:
+//   g++ -std=c++17 -O2 -o comments_test tests/comments_test.cpp && ./comments_test
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "../common/comments.hpp"
+#include "../common/io.hpp"
+#include "../common/strip.hpp"
+
+namespace {
+
+// Выход в строку.
+class StringOutput : public io::Output {
+public:
+  std::string text;
+
+protected:
+  bool sink(const char *p, std::size_t n) override {
+    text.append(p, n);
+    return true;
+  }
+};
+
+std::string comments_of(std::string_view in, comments::Format format) {
+  StringOutput listing;
+  {
+    comments::Writer writer(listing, format);
+    writer.start_file("a.c");
+    std::string code;
+    strip::StringSink sink{code};
+    strip::Stripper<strip::FullPolicy, comments::Writer> stripper(writer);
+    stripper.feed(in, sink);
+    stripper.finish(sink);
+  }
+  listing.close();
+  return listing.text;
+}
+
+int check(const char *name, const std::string &got,
+          std::string_view expected) {
+  if (got == expected) {
+    return 0;
+  }
+  std::printf("FAIL %s:\n  expected: %.*s\n  got:      %s\n", name,
+              static_cast<int>(expected.size()), expected.data(),
+              got.c_str());
+  return 1;
+}
+
+} // namespace
+
+int main() {
+  int failures = 0;
+  // Кавычки, управляющие символы и UTF-8 ("é") в тексте.
+  std::string_view in = "/* a */ int x; // \xc3\xa9\t\"\n";
+  failures += check(
+      "jsonl", comments_of(in, comments::Format::JSONL),
+      "{\"file\":\"a.c\",\"offset\":0,\"line\":1,\"kind\":\"block\",\"text\":"
+      "\" a \"}\n"
+      "{\"file\":\"a.c\",\"offset\":15,\"line\":1,\"kind\":\"line\",\"text\":"
+      "\" \xc3\xa9\\u0009\\\"\"}\n");
+  std::string binary = comments_of(in, comments::Format::BINARY);
+  if (binary.compare(0, 8, "TPLCMT1\n") != 0 ||
+      binary.find(" \xc3\xa9\t\"") == std::string::npos) {
+    std::printf("FAIL binary: header or comment bytes\n");
+    ++failures;
+  }
+  // Комментарий в CP1251 ("Привет"): байты вне UTF-8 идут как Latin-1,
+  // правильный UTF-8 ("é") и управляющие символы - как обычно.
+  in = "/* \xcf\xf0\xe8\xe2\xe5\xf2 */ int x; // \xc3\xa9\t\"\n";
+  failures += check(
+      "jsonl, not UTF-8", comments_of(in, comments::Format::JSONL),
+      "{\"file\":\"a.c\",\"offset\":0,\"line\":1,\"kind\":\"block\",\"text\":"
+      "\" \\u00cf\\u00f0\\u00e8\\u00e2\\u00e5\\u00f2 \"}\n"
+      "{\"file\":\"a.c\",\"offset\":20,\"line\":1,\"kind\":\"line\",\"text\":"
+      "\" \xc3\xa9\\u0009\\\"\"}\n");
+  // Обрезанные, лишне длинные и суррогатные последовательности.
+  failures += check("jsonl, broken UTF-8",
+                    comments_of("//\xc3 \xe2\x82 \xc0\xaf \xed\xa0\x80\n",
+                                comments::Format::JSONL),
+                    "{\"file\":\"a.c\",\"offset\":0,\"line\":1,\"kind\":"
+                    "\"line\",\"text\":\"\\u00c3 \\u00e2\\u0082 \\u00c0"
+                    "\\u00af \\u00ed\\u00a0\\u0080\"}\n");
+  // В двоичном формате байты текста не меняются.
+  binary = comments_of(in, comments::Format::BINARY);
+  if (binary.find(" \xcf\xf0\xe8\xe2\xe5\xf2 ") == std::string::npos) {
+    std::printf("FAIL binary: comment bytes changed\n");
+    ++failures;
+  }
+  std::printf("%d failure(s)\n", failures);
+  return failures == 0 ? 0 : 1;
+}
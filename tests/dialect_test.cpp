@@ -0,0 +1,127 @@
+// Регрессионные проверки автомата dialect::Stripper.
+// Сборка и запуск из корня репозитория:
+//   g++ -std=c++17 -O2 -o dialect_test tests/dialect_test.cpp && ./dialect_test
+// Каждый случай прогоняется частями всех длин, от одного байта до
+// целого входа: выход не должен зависеть от того, где вход разрезан.
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "../common/dialect.hpp"
+#include "../common/strip.hpp"
+
+namespace {
+
+struct Case {
+  const char *dialect;
+  std::string_view in;
+  std::string_view expected;
+};
+
+const Case cases[] = {
+    // Строки и комментарии в каждом языке таблицы.
+    {"c", "int a; /* b */ char c = '/'; // d\n", "int a;   char c = '/'; \n"},
+    {"cpp", "auto s = R\"x(// no )\" end)x\"; // c\n",
+     "auto s = R\"x(// no )\" end)x\"; \n"},
+    {"java", "String s = \"\"\"\n// keep \\\"\"\"\n\"\"\"; // c\n",
+     "String s = \"\"\"\n// keep \\\"\"\"\n\"\"\"; \n"},
+    {"js", "let s = `a // b`; /* c */ let t = 'd'; // e\n",
+     "let s = `a // b`;   let t = 'd'; \n"},
+    {"shell", "#!/bin/sh\necho a#b '#c' # d\n", "#!/bin/sh\necho a#b '#c' \n"},
+    {"python", "s = '''# keep''' # c\nt = \"#\"\n",
+     "s = '''# keep''' \nt = \"#\"\n"},
+    {"sql", "select '--x', \"/*y*/\" -- c\n/* d */",
+     "select '--x', \"/*y*/\" \n "},
+    // C++14: апостроф между цифрами - разделитель разрядов.
+    {"cpp", "int a = 0x1'0000; // c\nint b = 1'000'000, c = 0b10'10; // d\n",
+     "int a = 0x1'0000; \nint b = 1'000'000, c = 0b10'10; \n"},
+    {"cpp", "auto x = 0xFF'FF'AB + 1.5'0; char c = u8'a' + L'1'; // e\n",
+     "auto x = 0xFF'FF'AB + 1.5'0; char c = u8'a' + L'1'; \n"},
+    // JavaScript: регулярные выражения после знака, '(', ',' или '='.
+    {"js", "const r = /^https?:\\/\\//; // a\nf(/[/*]/g, x) /* b */\n",
+     "const r = /^https?:\\/\\//; \nf(/[/*]/g, x)  \n"},
+    {"js", "/re/.test(s); a = b / c / d; // e\nx = y\n/ 2; // f\n",
+     "/re/.test(s); a = b / c / d; \nx = y\n/ 2; \n"},
+    // Время жизни Rust - не символьный литерал.
+    {"rust",
+     "fn f<'a>(x: &'a str) -> &'a str { let u = \"it's // here\"; x } // c\n",
+     "fn f<'a>(x: &'a str) -> &'a str { let u = \"it's // here\"; x } \n"},
+    {"rust", "'outer: loop { break 'outer; } // c\nlet c = 'x'; // d\n",
+     "'outer: loop { break 'outer; } \nlet c = 'x'; \n"},
+    {"rust", "let q = '\\''; let u = '\xc3\xa9'; // c\n",
+     "let q = '\\''; let u = '\xc3\xa9'; \n"},
+    // Вложенные комментарии и сырые строки Rust.
+    {"rust", "a /* b /* c */ d */ e", "a   e"},
+    {"rust", "r\"C:\\\" // x\nr#\"say \"hi\" // x\"# /* y */",
+     "r\"C:\\\" \nr#\"say \"hi\" // x\"#  "},
+    {"rust", "br##\"a\"# \"##; r#type // z", "br##\"a\"# \"##; r#type "},
+    // Swift: апостроф не ограничивает литералы, сырые строки с #.
+    {"swift", "let s = \"it's\" // c\nlet t = \"don't\"\n",
+     "let s = \"it's\" \nlet t = \"don't\"\n"},
+    {"swift", "#\"a\\\" // b\"# /* c /* d */ e */ #\"\"\"\n\"\"\" //\n\"\"\"#",
+     "#\"a\\\" // b\"#   #\"\"\"\n\"\"\" //\n\"\"\"#"},
+    // Scala: символы 'name, вложенные комментарии, тройные кавычки без
+    // экранирования.
+    {"scala", "val s = 'sym; val c = 'c' /* a /* b */ c */\n",
+     "val s = 'sym; val c = 'c'  \n"},
+    {"scala", "val t = \"\"\"a\\\"\"\" // c\n", "val t = \"\"\"a\\\"\"\" \n"},
+    // Go: строки в обратных кавычках без экранирования.
+    {"go", "u := `http://a\\` // b\nv := `x\n// y` // z\nr := '`' // e\n",
+     "u := `http://a\\` \nv := `x\n// y` \nr := '`' \n"},
+    // C#: строки дословно и сырые строки в тройных кавычках.
+    {"csharp",
+     "var p = @\"C:\\\"; // a\nvar q = @\"say \"\"hi\"\" // b\"; // c\n",
+     "var p = @\"C:\\\"; \nvar q = @\"say \"\"hi\"\" // b\"; \n"},
+    {"csharp", "var i = $@\"{x}\\\"; var r = \"\"\"C:\\\"\"\"; // d\n",
+     "var i = $@\"{x}\\\"; var r = \"\"\"C:\\\"\"\"; \n"},
+    // Kotlin: тройные кавычки без экранирования, вложенные комментарии.
+    {"kotlin",
+     "val p = \"\"\"C:\\\"\"\" /* a /* b */ c */ val c = '\\'' // d\n",
+     "val p = \"\"\"C:\\\"\"\"   val c = '\\'' \n"},
+};
+
+std::string strip_in_chunks(const dialect::Dialect &d, std::string_view in,
+                            std::size_t chunk) {
+  std::string out;
+  strip::StringSink sink{out};
+  dialect::Stripper stripper(d);
+  for (std::size_t i = 0; i < in.size(); i += chunk) {
+    stripper.feed(in.substr(i, chunk), sink);
+  }
+  stripper.finish(sink);
+  return out;
+}
+
+} // namespace
+
+int main() {
+  int failures = 0;
+  for (const Case &c : cases) {
+    const dialect::Dialect &d = *dialect::find(c.dialect);
+    for (std::size_t size = 1; size <= c.in.size(); ++size) {
+      std::string out = strip_in_chunks(d, c.in, size);
+      if (out != c.expected) {
+        std::printf("FAIL %s, chunks of %zu:\n  in:       %.*s\n"
+                    "  expected: %.*s\n  got:      %s\n",
+                    c.dialect, size, static_cast<int>(c.in.size()),
+                    c.in.data(), static_cast<int>(c.expected.size()),
+                    c.expected.data(), out.c_str());
+        ++failures;
+        break;
+      }
+    }
+  }
+  if (dialect::for_path("src/main.rs") != dialect::find("rust") ||
+      dialect::for_path("App.swift") != dialect::find("swift") ||
+      dialect::for_path("Main.scala") != dialect::find("scala") ||
+      dialect::for_path("main.go") != dialect::find("go") ||
+      dialect::for_path("Program.cs") != dialect::find("csharp") ||
+      dialect::for_path("Main.kt") != dialect::find("kotlin")) {
+    std::printf("FAIL extensions of rust, swift, scala, go, csharp or "
+                "kotlin\n");
+    ++failures;
+  }
+  std::printf("%d failure(s)\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+// Регрессионные проверки сжатия пробелов (strip.hpp с minify.hpp).
+// Сборка и запуск из корня репозитория:
+//   g++ -std=c++17 -O2 -o minify_test tests/minify_test.cpp && ./minify_test
+// Каждый случай прогоняется частями всех длин, от одного байта до
+// целого входа: выход не должен зависеть от того, где вход разрезан.
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "../common/strip.hpp"
+
+namespace {
+
+struct Case {
+  std::string_view in;
+  std::string_view expected;
+};
+
+const Case cases[] = {
+    {"int  a = b +  c ; /* d */ return a ;\n", "int a=b+c;return a;\n"},
+    {"x = 1e -1; y = a + +b;\n", "x=1e -1;y=a+ +b;\n"},
+    // Пробел перед '(' в #define отделяет макрос-объект от макроса-функции.
+    {"#define F (x)\nint y = F ;\n", "#define F (x)\nint y=F;\n"},
+    {"#  define  F/* c */(x) + 1\n", "#define F (x)+1\n"},
+    {"#define F \\\n  (x)\n", "#define F \\\n (x)\n"},
+    {"#define G(x) (x)\n#if defined (G)\n#endif\n",
+     "#define G(x)(x)\n#if defined(G)\n#endif\n"},
+};
+
+std::string minify_in_chunks(std::string_view in, std::size_t chunk) {
+  std::string out;
+  strip::StringSink sink{out};
+  strip::Stripper<strip::FullMinifyPolicy> stripper;
+  for (std::size_t i = 0; i < in.size(); i += chunk) {
+    stripper.feed(in.substr(i, chunk), sink);
+  }
+  stripper.finish(sink);
+  return out;
+}
+
+} // namespace
+
+int main() {
+  int failures = 0;
+  for (const Case &c : cases) {
+    for (std::size_t size = 1; size <= c.in.size(); ++size) {
+      std::string out = minify_in_chunks(c.in, size);
+      if (out != c.expected) {
+        std::printf("FAIL chunks of %zu:\n  in:       %.*s\n"
+                    "  expected: %.*s\n  got:      %s\n",
+                    size, static_cast<int>(c.in.size()), c.in.data(),
+                    static_cast<int>(c.expected.size()), c.expected.data(),
+                    out.c_str());
+        ++failures;
+        break;
+      }
+    }
+  }
+  std::printf("%d failure(s)\n", failures);
+  return failures == 0 ? 0 : 1;
+}